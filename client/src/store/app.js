@@ -4,12 +4,41 @@ import { SolverD3 } from 'ratio-solver/src/solverD3.js'
 import { SensorType } from '../sensor.js'
 import { SensorD3 } from '../sensorD3.js'
 import { nextTick } from 'vue';
+import { decode } from '../msgpack.js';
 
-export const server = {
-  host: 'localhost',
-  port: 8080
+// the client talks to the server it is served by (the primary, or one of its relays), but for the development server..
+export const server = import.meta.env.DEV ? {
+  origin: 'http://localhost:8080',
+  ws: 'ws://localhost:8080'
+} : {
+  origin: location.origin,
+  ws: (location.protocol === 'https:' ? 'wss://' : 'ws://') + location.host
 }
 
+// the client acknowledges the received messages every `ack_every` messages or every `ack_interval` milliseconds, so that the server can detect slow consumers..
+const ack_every = 64;
+const ack_interval = 250;
+
+// some browsers have the decompression streams, yet without the raw deflate format, rejected when the stream is constructed..
+const deflate_raw = (() => {
+  try {
+    new DecompressionStream('deflate-raw');
+    return true;
+  } catch {
+    return false;
+  }
+})();
+
+// compressed frames start with the 0xC1 byte (never used by MessagePack), followed by a raw deflate stream of a JSON text or of a MessagePack value..
+const parse_frame = async (data) => {
+  if (typeof data === 'string')
+    return JSON.parse(data);
+  let bytes = new Uint8Array(data);
+  if (bytes[0] === 0xc1)
+    bytes = new Uint8Array(await new Response(new Blob([bytes.subarray(1)]).stream().pipeThrough(new DecompressionStream('deflate-raw'))).arrayBuffer());
+  return bytes[0] === 0x7b ? JSON.parse(new TextDecoder().decode(bytes)) : decode(bytes.buffer);
+};
+
 const SpeechRecognition = window.SpeechRecognition || webkitSpeechRecognition;
 const SpeechGrammarList = window.SpeechGrammarList || webkitSpeechGrammarList;
 
@@ -24,6 +53,7 @@ export const useAppStore = defineStore('app', {
     sensor_types: new Map(),
     sensors: new Map(),
     solvers: new Map(),
+    graph_versions: new Map(),
     users: new Map(),
     speech_recognition: new SpeechRecognition(),
     listening: false,
@@ -34,7 +64,7 @@ export const useAppStore = defineStore('app', {
   }),
   actions: {
     login(email, password) {
-      fetch('http://' + server.host + ':' + server.port + '/login', {
+      fetch(server.origin + '/login', {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json'
@@ -60,171 +90,216 @@ export const useAppStore = defineStore('app', {
       this.sensor_types.clear();
       this.sensors.clear();
       this.solvers.clear();
+      this.graph_versions.clear();
       this.users.clear();
       this.login_dialog = true;
     },
-    connect(url = 'ws://' + server.host + ':' + server.port + '/coco', timeout = 1000) {
+    connect(url = server.ws + '/coco', timeout = 1000) {
       this.socket = new WebSocket(url);
+      this.socket.binaryType = 'arraybuffer';
+      let received = 0, acked = 0;
+      const ack = () => {
+        if (received !== acked && this.socket.readyState === WebSocket.OPEN) {
+          this.socket.send(JSON.stringify({ 'type': 'ack', 'token': this.token, 'received': received }));
+          acked = received;
+        }
+      };
+      const ack_timer = setInterval(ack, ack_interval);
       this.socket.onopen = () => {
-        this.socket.send(JSON.stringify({ 'type': 'login', 'token': this.token }));
+        const versions = Array.from(this.graph_versions, ([solver_id, v]) => ({ 'solver_id': solver_id, 'epoch': v.epoch, 'version': v.version }));
+        this.socket.send(JSON.stringify({ 'type': 'login', 'token': this.token, 'ack': true, 'format': 'msgpack', 'compress': deflate_raw, 'versions': versions }));
       };
       this.socket.onclose = () => {
+        clearInterval(ack_timer);
         setTimeout(() => { this.connect(url, timeout); }, timeout);
       };
+      // the frames are decompressed asynchronously, so we chain them to handle the messages in order..
+      let frames = Promise.resolve();
       this.socket.onmessage = (msg) => {
-        let data = JSON.parse(msg.data);
-        switch (data.type) {
-          case 'login':
-            if (data.success)
-              this.user = data.user;
-            else
-              this.logout();
-            break;
-          case 'users':
-            this.users.clear();
-            for (let user of data.users)
-              this.users.set(user.id, user);
-            break;
-          case 'new_user':
-            this.users.set(data.user.id, data.user);
-            break;
-          case 'updated_user':
-            this.users.set(data.user.id, data.user);
-            break;
-          case 'removed_user':
-            this.users.delete(data.user);
-            break;
-          case 'user_connected':
-            if (this.users.has(data.user))
-              this.users.get(data.user).connected = true;
-            break;
-          case 'user_disconnected':
-            if (this.users.has(data.user))
-              this.users.get(data.user).connected = false;
-            break;
-          case 'sensor_types':
-            this.sensor_types.clear();
-            for (let sensor_type of data.sensor_types) {
-              const parameters = new Map();
-              for (let parameter of sensor_type.parameters)
-                parameters.set(parameter.name, this.parameter_type(parameter.type));
-              this.sensor_types.set(sensor_type.id, new SensorType(sensor_type.id, sensor_type.name, sensor_type.description, parameters));
-            }
-            break;
-          case 'new_sensor_type':
+        frames = frames.then(() => parse_frame(msg.data)).then((data) => {
+          this.handle_message(data);
+          if (++received - acked >= ack_every)
+            ack();
+        }).catch((err) => console.error(err));
+      };
+    },
+    handle_message(data) {
+      if (data.version !== undefined && data.type !== 'batch' && data.type !== 'graph') {
+        // solver events are versioned: we skip those already included in the graph we have..
+        const v = this.graph_versions.get(data.solver_id);
+        if (v) {
+          if (data.version <= v.version)
+            return;
+          v.version = data.version;
+        }
+      }
+      switch (data.type) {
+        case 'batch':
+          for (let m of data.messages)
+            this.handle_message(m);
+          break;
+        case 'login':
+          if (data.success)
+            this.user = data.user;
+          else
+            this.logout();
+          break;
+        case 'users':
+          this.users.clear();
+          for (let user of data.users)
+            this.users.set(user.id, user);
+          break;
+        case 'new_user':
+          this.users.set(data.user.id, data.user);
+          break;
+        case 'updated_user':
+          this.users.set(data.user.id, data.user);
+          break;
+        case 'removed_user':
+          this.users.delete(data.user);
+          break;
+        case 'user_connected':
+          if (this.users.has(data.user))
+            this.users.get(data.user).connected = true;
+          break;
+        case 'user_disconnected':
+          if (this.users.has(data.user))
+            this.users.get(data.user).connected = false;
+          break;
+        case 'sensor_types':
+          this.sensor_types.clear();
+          for (let sensor_type of data.sensor_types) {
             const parameters = new Map();
-            for (let parameter of data.sensor_type.parameters)
+            for (let parameter of sensor_type.parameters)
               parameters.set(parameter.name, this.parameter_type(parameter.type));
-            this.sensor_types.set(data.sensor_type.id, new SensorType(data.sensor_type.id, data.sensor_type.name, data.sensor_type.description, parameters));
-            break;
-          case 'updated_sensor_type':
-            const sensor_type = this.sensor_types.get(data.sensor_type.id);
-            sensor_type.name = data.sensor_type.name;
-            sensor_type.description = data.sensor_type.description;
-            sensor_type.parameters.clear();
-            for (let parameter of data.sensor_type.parameters)
-              sensor_type.parameters.set(parameter.name, this.parameter_type(parameter.type));
-            break;
-          case 'removed_sensor_type':
-            this.sensor_types.delete(data.sensor_type);
-            break;
-          case 'sensors':
-            this.sensors.clear();
-            for (let sensor of data.sensors)
-              this.sensors.set(sensor.id, new SensorD3(sensor.id, sensor.name, this.sensor_types.get(sensor.type), sensor.value, sensor.state));
-            break;
-          case 'new_sensor':
-            this.sensors.set(data.sensor.id, new SensorD3(data.sensor.id, data.sensor.name, this.sensor_types.get(data.sensor.type), data.sensor.value, data.sensor.state));
-            break;
-          case 'updated_sensor':
-            this.sensors.set(data.sensor.id, data.sensor);
-            break;
-          case 'removed_sensor':
-            this.sensors.delete(data.sensor);
-            break;
-          case 'new_sensor_value':
-            this.sensors.get(data.sensor).add_value({ 'timestamp': data.timestamp * 1000, 'value': data.value });
-            break;
-          case 'new_sensor_state':
-            this.sensors.get(data.sensor).state = data.state;
-            break;
-          case 'solvers':
-            this.solvers.clear();
-            for (let solver of data.solvers)
-              this.solvers.set(solver.id, new SolverD3(solver.id, solver.name, solver.state));
-            nextTick(() => {
-              for (let [id, slv] of this.solvers)
-                slv.init(this.get_timelines_id(id), this.get_graph_id(id), 1000, 400);
-            });
-            break;
-          case 'solver_created':
-            const slv = new SolverD3(data.solver_id, data.name, data.state);
-            this.solvers.set(data.solver_id, slv);
-            nextTick(() => { slv.init(this.get_timelines_id(slv.id), this.get_graph_id(slv.id), 1000, 400); });
-            break;
-          case 'solver_destroyed':
-            this.solvers.delete(data.solver_id);
-            break;
-          case 'state_changed':
-            this.solvers.get(data.solver_id).state_changed(data);
-            break;
-          case 'graph':
-            this.solvers.get(data.solver_id).graph(data);
-            break;
-          case 'flaw_created':
-            this.solvers.get(data.solver_id).flaw_created(data);
-            break;
-          case 'flaw_state_changed':
-            this.solvers.get(data.solver_id).flaw_state_changed(data);
-            break;
-          case 'flaw_cost_changed':
-            this.solvers.get(data.solver_id).flaw_cost_changed(data);
-            break;
-          case 'flaw_position_changed':
-            this.solvers.get(data.solver_id).flaw_position_changed(data);
-            break;
-          case 'current_flaw':
-            this.solvers.get(data.solver_id).current_flaw_changed(data);
-            break;
-          case 'resolver_created':
-            this.solvers.get(data.solver_id).resolver_created(data);
-            break;
-          case 'resolver_state_changed':
-            this.solvers.get(data.solver_id).resolver_state_changed(data);
-            break;
-          case 'current_resolver':
-            this.solvers.get(data.solver_id).current_resolver_changed(data);
-            break;
-          case 'causal_link_added':
-            this.solvers.get(data.solver_id).causal_link_added(data);
-            break;
-          case 'executor_state_changed':
-            if (this.solvers.has(data.solver_id))
-              this.solvers.get(data.solver_id).executor_state_changed(data);
-            break;
-          case 'tick':
-            this.solvers.get(data.solver_id).tick(data);
-            break;
-          case 'starting':
-            this.solvers.get(data.solver_id).starting(data);
-            break;
-          case 'ending':
-            this.solvers.get(data.solver_id).ending(data);
-            break;
-          case 'start':
-            this.solvers.get(data.solver_id).start(data);
-            break;
-          case 'end':
-            this.solvers.get(data.solver_id).end(data);
-            break;
-        }
-      };
+            this.sensor_types.set(sensor_type.id, new SensorType(sensor_type.id, sensor_type.name, sensor_type.description, parameters));
+          }
+          break;
+        case 'new_sensor_type':
+          const parameters = new Map();
+          for (let parameter of data.sensor_type.parameters)
+            parameters.set(parameter.name, this.parameter_type(parameter.type));
+          this.sensor_types.set(data.sensor_type.id, new SensorType(data.sensor_type.id, data.sensor_type.name, data.sensor_type.description, parameters));
+          break;
+        case 'updated_sensor_type':
+          const sensor_type = this.sensor_types.get(data.sensor_type.id);
+          sensor_type.name = data.sensor_type.name;
+          sensor_type.description = data.sensor_type.description;
+          sensor_type.parameters.clear();
+          for (let parameter of data.sensor_type.parameters)
+            sensor_type.parameters.set(parameter.name, this.parameter_type(parameter.type));
+          break;
+        case 'removed_sensor_type':
+          this.sensor_types.delete(data.sensor_type);
+          break;
+        case 'sensors':
+          this.sensors.clear();
+          for (let sensor of data.sensors)
+            this.sensors.set(sensor.id, new SensorD3(sensor.id, sensor.name, this.sensor_types.get(sensor.type), sensor.value, sensor.state));
+          break;
+        case 'new_sensor':
+          this.sensors.set(data.sensor.id, new SensorD3(data.sensor.id, data.sensor.name, this.sensor_types.get(data.sensor.type), data.sensor.value, data.sensor.state));
+          break;
+        case 'updated_sensor':
+          this.sensors.set(data.sensor.id, data.sensor);
+          break;
+        case 'removed_sensor':
+          this.sensors.delete(data.sensor);
+          break;
+        case 'new_sensor_value':
+          this.sensors.get(data.sensor).add_value({ 'timestamp': data.timestamp * 1000, 'value': data.value });
+          break;
+        case 'new_sensor_state':
+          this.sensors.get(data.sensor).state = data.state;
+          break;
+        case 'solvers':
+          // we keep the solvers we already have, so that their graphs can be brought up to date..
+          for (let id of Array.from(this.solvers.keys()))
+            if (!data.solvers.some(solver => solver.id === id)) {
+              this.solvers.delete(id);
+              this.graph_versions.delete(id);
+            }
+          const new_solvers = [];
+          for (let solver of data.solvers)
+            if (!this.solvers.has(solver.id)) {
+              const n_slv = new SolverD3(solver.id, solver.name, solver.state);
+              this.solvers.set(solver.id, n_slv);
+              new_solvers.push(n_slv);
+            }
+          nextTick(() => {
+            for (let n_slv of new_solvers)
+              n_slv.init(this.get_timelines_id(n_slv.id), this.get_graph_id(n_slv.id), 1000, 400);
+          });
+          break;
+        case 'solver_created':
+          const slv = new SolverD3(data.solver_id, data.name, data.state);
+          this.solvers.set(data.solver_id, slv);
+          nextTick(() => { slv.init(this.get_timelines_id(slv.id), this.get_graph_id(slv.id), 1000, 400); });
+          break;
+        case 'solver_destroyed':
+          this.solvers.delete(data.solver_id);
+          this.graph_versions.delete(data.solver_id);
+          break;
+        case 'state_changed':
+          this.solvers.get(data.solver_id).state_changed(data);
+          break;
+        case 'graph':
+          this.graph_versions.set(data.solver_id, { epoch: data.epoch, version: data.version });
+          this.solvers.get(data.solver_id).graph(data);
+          break;
+        case 'flaw_created':
+          this.solvers.get(data.solver_id).flaw_created(data);
+          break;
+        case 'flaw_state_changed':
+          this.solvers.get(data.solver_id).flaw_state_changed(data);
+          break;
+        case 'flaw_cost_changed':
+          this.solvers.get(data.solver_id).flaw_cost_changed(data);
+          break;
+        case 'flaw_position_changed':
+          this.solvers.get(data.solver_id).flaw_position_changed(data);
+          break;
+        case 'current_flaw':
+          this.solvers.get(data.solver_id).current_flaw_changed(data);
+          break;
+        case 'resolver_created':
+          this.solvers.get(data.solver_id).resolver_created(data);
+          break;
+        case 'resolver_state_changed':
+          this.solvers.get(data.solver_id).resolver_state_changed(data);
+          break;
+        case 'current_resolver':
+          this.solvers.get(data.solver_id).current_resolver_changed(data);
+          break;
+        case 'causal_link_added':
+          this.solvers.get(data.solver_id).causal_link_added(data);
+          break;
+        case 'executor_state_changed':
+          if (this.solvers.has(data.solver_id))
+            this.solvers.get(data.solver_id).executor_state_changed(data);
+          break;
+        case 'tick':
+          this.solvers.get(data.solver_id).tick(data);
+          break;
+        case 'starting':
+          this.solvers.get(data.solver_id).starting(data);
+          break;
+        case 'ending':
+          this.solvers.get(data.solver_id).ending(data);
+          break;
+        case 'start':
+          this.solvers.get(data.solver_id).start(data);
+          break;
+        case 'end':
+          this.solvers.get(data.solver_id).end(data);
+          break;
+      }
     },
     new_sensor_type(name, description, parameters) {
       const par_dict = {};
       for (let par of parameters)
         par_dict[par.name] = par.type;
-      fetch('http://' + server.host + ':' + server.port + '/sensor_type', {
+      fetch(server.origin + '/sensor_type', {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json',
@@ -237,7 +312,7 @@ export const useAppStore = defineStore('app', {
       });
     },
     new_sensor(name, description, type, location) {
-      fetch('http://' + server.host + ':' + server.port + '/sensor', {
+      fetch(server.origin + '/sensor', {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json',
@@ -250,7 +325,7 @@ export const useAppStore = defineStore('app', {
       });
     },
     new_user(first_name, last_name, email, password) {
-      fetch('http://' + server.host + ':' + server.port + '/user', {
+      fetch(server.origin + '/user', {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json',
@@ -263,7 +338,7 @@ export const useAppStore = defineStore('app', {
       });
     },
     publish_sensor_value(sensor, value) {
-      fetch('http://' + server.host + ':' + server.port + '/sensor/' + sensor, {
+      fetch(server.origin + '/sensor/' + sensor, {
         method: 'POST',
         headers: {
           'Content-Type': 'application/json',
@@ -272,6 +347,24 @@ export const useAppStore = defineStore('app', {
         body: JSON.stringify(value)
       });
     },
+    // once subscribed, the session receives the solver and sensor streams only for the subscribed solvers, sensors and sensor types..
+    subscribe(solvers = [], sensors = [], sensor_types = []) {
+      if (this.socket && this.socket.readyState === WebSocket.OPEN) {
+        const versions = solvers.filter((solver_id) => this.graph_versions.has(solver_id)).map((solver_id) => ({ 'solver_id': solver_id, 'epoch': this.graph_versions.get(solver_id).epoch, 'version': this.graph_versions.get(solver_id).version }));
+        this.socket.send(JSON.stringify({ 'type': 'subscribe', 'token': this.token, 'solvers': solvers, 'sensors': sensors, 'sensor_types': sensor_types, 'versions': versions }));
+      }
+    },
+    unsubscribe(solvers = [], sensors = [], sensor_types = []) {
+      if (this.socket && this.socket.readyState === WebSocket.OPEN)
+        this.socket.send(JSON.stringify({ 'type': 'unsubscribe', 'token': this.token, 'solvers': solvers, 'sensors': sensors, 'sensor_types': sensor_types }));
+    },
+    // the session receives, again, every stream, starting from a full snapshot..
+    subscribe_all() {
+      if (this.socket && this.socket.readyState === WebSocket.OPEN) {
+        const versions = Array.from(this.graph_versions, ([solver_id, v]) => ({ 'solver_id': solver_id, 'epoch': v.epoch, 'version': v.version }));
+        this.socket.send(JSON.stringify({ 'type': 'subscribe_all', 'token': this.token, 'versions': versions }));
+      }
+    },
     init_speech_recognition() {
       this.speech_recognition.interimResults = true;
       this.speech_recognition.lang = 'it-IT';
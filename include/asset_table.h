@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <map>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief An immutable, in-memory, table of the static assets of the client.
+   *
+   * The files are read once, when the table is built, along with their compressed variants, so that serving them takes neither file I/O nor compression. The gzip variant is computed when the build did not provide one, while the brotli variant is taken only from the build (i.e., from a `.br` file next to the asset).
+   */
+  class asset_table
+  {
+  public:
+    struct asset
+    {
+      std::string content_type;
+      std::string etag; // a strong validator, computed on the uncompressed content..
+      bool immutable;   // whether the name of the asset changes with its content, so that it can be cached forever..
+      std::string body, gzip, brotli; // the compressed variants are empty if not worth it..
+    };
+
+    /**
+     * @brief Loads the assets under the given directory, which are then served by their path relative to it.
+     */
+    asset_table(const std::filesystem::path &root);
+
+    /**
+     * @brief Returns the asset with the given path (e.g., `/assets/index-1a2b3c4d.js`), or nullptr if there is no such asset.
+     */
+    const asset *find(const std::string_view &path) const;
+    std::size_t size() const { return assets.size(); }
+
+  private:
+    std::map<std::string, asset, std::less<>> assets;
+  };
+} // namespace coco::coco_gui
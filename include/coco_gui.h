@@ -2,23 +2,159 @@
 
 #include "server.h"
 #include "coco_listener.h"
+#include "mpsc_queue.h"
+#include "graph_model.h"
+#include "sensor_series.h"
+#include "router.h"
+#include "metrics.h"
+#include "event_log.h"
+#include "asset_table.h"
+#include "upstream.h"
+#include <algorithm>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <unordered_set>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+#include <future>
 
 namespace coco::coco_gui
 {
+  enum class slow_consumer_policy
+  {
+    drop,      // keep only the latest message for each key, until the client catches up
+    resync,    // stop sending and send a fresh snapshot once the client has drained its queue
+    disconnect // close the session
+  };
+
+  enum class wire_format
+  {
+    json,   // text frames
+    msgpack // MessagePack binary frames
+  };
+
+  enum class write_durability
+  {
+    enqueued, // the sensor values are acknowledged once queued, being written in the background (the default)..
+    committed // the sensor values are acknowledged once written, the io thread waiting for the writer thread..
+  };
+
   class coco_gui : public network::server, public coco::coco_listener
   {
   public:
-    coco_gui(coco::coco_core &cc, const std::string &coco_host = COCO_HOST, const unsigned short coco_port = COCO_PORT);
+    coco_gui(coco::coco_core &cc, const std::string &coco_host = COCO_HOST, const unsigned short coco_port = COCO_PORT, const std::size_t concurrency = COCO_CONCURRENCY ? COCO_CONCURRENCY : std::max(std::thread::hardware_concurrency(), 1u)); // hardware_concurrency gives 0 when it cannot tell, hence at least one thread..
+    ~coco_gui();
+
+    void set_batch_window(const std::chrono::milliseconds &window) { batch_window = window.count(); }
+    void set_batch_size(const std::size_t size) { batch_size = size; }
+    void set_high_water_mark(const std::size_t hwm) { high_water_mark = hwm; }
+    void set_slow_consumer_policy(const slow_consumer_policy policy) { slow_consumer = policy; }
+    void set_compression_threshold(const std::size_t threshold) { compression_threshold = threshold; }
+    void set_write_durability(const write_durability d) { durability = d; }
+    /**
+     * @brief Sets the maximum number of tick and execution updates sent per second for each solver (zero sends every update as it happens).
+     */
+    void set_execution_rate(const double rate) { execution_rate = rate; }
+    /**
+     * @brief Sets the number of recent values kept in memory for the sensors of the given type (zero disables the buffering). Applies to the buffers created afterwards.
+     */
+    void set_recent_values_capacity(const std::string &sensor_type_id, const std::size_t capacity)
+    {
+      std::lock_guard<std::mutex> _(recent_values_mtx);
+      recent_values_capacity[sensor_type_id] = capacity;
+    }
+
+    /**
+     * @brief Sets whether the core is initialized. While it is not, the REST API (but the readiness route) answers with 503 and the WebSocket logins are refused, the clients retrying later.
+     *
+     * Once ready, the cached responses are built in the background, so that the first clients do not wait for them.
+     */
+    void set_ready(const bool r);
+    /**
+     * @brief Records how long the given startup phase (e.g., the loading of the rules) took, exposed through the `/metrics` route.
+     */
+    void startup_phase(const std::string &phase, const std::chrono::steady_clock::duration &d);
+
+    /**
+     * @brief Starts recording, into the given event log, the messages fed to the fan-out and the solver events fed to the batching.
+     */
+    void start_recording(const std::string &path) { std::atomic_store(&recorder, std::make_shared<event_log_writer>(path)); }
+    void stop_recording() { std::atomic_store(&recorder, std::shared_ptr<event_log_writer>()); }
+    /**
+     * @brief Feeds the events of the given log to the batching and to the fan-out, as if they were coming from the core.
+     *
+     * @param speed the factor the recorded pace is accelerated by (zero replays the events as fast as possible).
+     * @return std::size_t the number of replayed events.
+     */
+    std::size_t replay(const std::string &path, const double speed = 1);
+    /**
+     * @brief Lets the WebSocket clients log in with any token, as plain users, without looking them up in the database. Meant for replaying event logs offline.
+     */
+    void set_guest_logins(const bool guests) { guest_logins = guests; }
+
+    /**
+     * @brief Makes this server a relay of the given primary server, to be called before the server starts.
+     *
+     * A relay serves the `/coco` stream of the primary, along with the users, sensor types and sensors lists, to its own clients, taking care of their logins and of bringing them up to date. The other routes of the API are redirected to the primary.
+     *
+     * @param token the token of an admin of the primary, which the relay subscribes to the whole stream with.
+     */
+    void set_upstream(const std::string &host, const std::string &port, const std::string &token) { upstream = upstream_node{host, port, token}; }
+    /**
+     * @brief Receives the stream of the primary server and fans it out to the sessions of this relay, reconnecting whenever the connection drops. The server is ready once the first snapshot of the primary has been received.
+     */
+    void relay();
 
   private:
+    /**
+     * @brief Resolves the request against the route table and calls the handler of the matching route.
+     */
+    void dispatch(network::request &req, network::response &res);
+
+    struct api_route
+    {
+      std::function<void(network::request &, network::response &, const path_params &)> handle;
+      route_metrics &metrics;
+    };
+    void add_api_route(const boost::beast::http::verb verb, const std::string_view &pattern, std::function<void(network::request &, network::response &, const path_params &)> &&handle);
+
+    /**
+     * @brief Serves the static assets of the client from memory, in the best encoding the client accepts.
+     */
+    void serve_asset(network::request &req, network::response &res);
+
     void login(network::request &req, network::response &res);
 
     bool authorize(network::request &req, network::response &res, bool admin = false);
 
+    struct principal
+    {
+      std::string id;
+      bool admin;
+      bool member;     // whether the user belongs to the root of this server, which the WebSocket logins require..
+      json::json user; // the user, as sent in the `login` message..
+      std::chrono::steady_clock::time_point expires;
+    };
+    /**
+     * @brief Resolves the given token, through the database or, on a relay, through the `/principal` route of the primary.
+     *
+     * @return the principal of the token, or null if the token is not that of a user.
+     * @throws upstream_error if a relay cannot check the token with its primary.
+     */
+    std::shared_ptr<const principal> get_principal(const std::string &token);
+    void forget_principal(const std::string &token);
+    /**
+     * @brief Answers with the user of the token, whether it is an admin and whether it belongs to the root of this server, for the relays to check the tokens of their clients.
+     */
+    void get_principal(network::request &req, network::response &res);
+
     void get_users(network::request &req, network::response &res);
     void create_user(network::request &req, network::response &res);
-    void update_user(network::request &req, network::response &res);
-    void delete_user(network::request &req, network::response &res);
+    void update_user(network::request &req, network::response &res, const std::string &user_id);
+    void delete_user(network::request &req, network::response &res, const std::string &user_id);
 
     void get_sensor_types(network::request &req, network::response &res);
     void create_sensor_type(network::request &req, network::response &res);
@@ -26,8 +162,65 @@ namespace coco::coco_gui
     void get_sensors(network::request &req, network::response &res);
     void create_sensor(network::request &req, network::response &res);
 
-    void get_sensor_values(network::request &req, network::response &res);
-    void publish_sensor_value(network::request &req, network::response &res);
+    void get_sensor_values(network::request &req, network::response &res, const std::string &sensor_id);
+    void publish_sensor_value(network::request &req, network::response &res, const std::string &sensor_id);
+    void publish_sensor_values(network::request &req, network::response &res);
+    static std::optional<std::string> validate_sensor_value(const std::map<std::string, parameter_type> &parameters, json::json &value);
+
+    struct write_request
+    {
+      std::promise<bool> written; // fulfilled, with whether all the values were written, once the last value of the request is..
+      std::atomic<bool> ok{true};
+    };
+    struct pending_value
+    {
+      std::string sensor_id;
+      json::json value;
+      std::shared_ptr<write_request> request;
+      bool last; // whether this is the last value of its request..
+      std::chrono::steady_clock::time_point queued;
+    };
+    /**
+     * @brief Queues the given values for the writer thread and, if the durability requires it, waits for them to be written.
+     *
+     * @return false, having answered the request, if the queue is full or the values could not be written.
+     */
+    bool write_behind(network::response &res, std::vector<std::pair<std::string, json::json>> &&values);
+    /**
+     * @brief Writes the queued sensor values, one at a time, until stopped and drained.
+     *
+     * COCO writes each value on its own, hence the writer amortizes only the queueing: it takes the values from the queue up to `COCO_WRITE_BATCH_SIZE` at once, yet takes the core mutex (and writes) once per value, so as not to hold up the solvers.
+     */
+    void write_values();
+
+    /**
+     * @brief Calls the given function, in order, on the values of the sensor within the [from, to] interval, until the function returns false.
+     *
+     * @param batch the number of values the function is expected to take, which sizes the reads from the database.
+     */
+    void for_each_sensor_value(const std::string &sensor_id, const std::chrono::system_clock::time_point &from, const std::chrono::system_clock::time_point &to, const std::size_t batch, const std::function<bool(json::json &)> &f);
+
+    /**
+     * @brief Whether a relay serves the given route itself, rather than redirecting it to the primary.
+     */
+    static bool relayed_route(const boost::beast::http::verb verb, const std::string_view &path);
+
+    void get_sessions(network::request &req, network::response &res);
+    void get_metrics(network::request &req, network::response &res);
+    void get_ready(network::request &req, network::response &res);
+    /**
+     * @brief Records, if not done yet, the time to the first response since the server was launched.
+     */
+    void responded()
+    {
+      if (first_response_us.load(std::memory_order_relaxed) < 0)
+      {
+        long long expected = -1;
+        first_response_us.compare_exchange_strong(expected, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - launched).count());
+      }
+    }
+    void get_lock_profile(network::request &req, network::response &res);
+    void update_lock_profile(network::request &req, network::response &res);
 
   private:
     void on_ws_open(network::websocket_session &ws);
@@ -75,10 +268,371 @@ namespace coco::coco_gui
     void end(const coco_executor &exec, const std::unordered_set<ratio::atom *> &atoms) override;
 
   private:
-    void broadcast(const std::string &&msg, bool to_all = true);
+    struct frame
+    {
+      utils::c_ptr<network::message> msg;
+      std::size_t size;
+    };
+
+    struct session_sync;
+    struct outgoing_message
+    {
+      utils::c_ptr<network::message> msg;           // the plain JSON frame (built by the fan-out thread, from the text, when some session needs another encoding)..
+      std::size_t size;
+      bool to_all;
+      std::string key;                               // messages with the same key supersede each other..
+      std::vector<std::string> topics;               // the topics of the message (none for the messages to every session)..
+      std::shared_ptr<std::string> text;             // the JSON text, while some session needs another encoding, moved into the plain frame once the encodings are built..
+      std::optional<frame> bin, z_text, z_bin;       // the other encodings, built once by the fan-out thread for all the sessions which need them..
+      std::shared_ptr<session_sync> sync;            // set, the message being empty, for the points at which a session joins the stream..
+    };
+
+    struct gui_session
+    {
+      gui_session(const std::uint64_t id, network::websocket_session &ws, const std::string &user_id, bool admin, wire_format format, bool compress, bool relay) : id(id), ws(ws), user_id(user_id), admin(admin), format(format), compress(compress), relay(relay) {}
+
+      const std::uint64_t id;
+      network::websocket_session &ws;
+      const std::string user_id;
+      const bool admin;
+      const wire_format format;
+      const bool compress; // whether the large messages are sent compressed..
+      const bool relay;    // whether the session feeds a relay, which is never disconnected for being slow..
+
+      std::mutex mtx;
+      std::size_t acked = 0;             // the number of messages acknowledged by the client (a client which never acknowledges is handled as a slow one)..
+      std::deque<std::size_t> in_flight; // the sizes of the messages sent but not yet acknowledged..
+      std::size_t in_flight_bytes = 0;
+      std::vector<outgoing_message> held; // the latest keyed messages, held while the session is over its high-water mark..
+      std::unordered_map<std::string, std::size_t> held_index;
+      bool stale = false;   // the session is waiting for a fresh snapshot..
+      bool syncing = false; // the fresh snapshot is queued..
+      bool closing = false; // the session is being closed..
+
+      std::unordered_set<std::string> topics; // the subscribed topics (guarded by the registry mutex)..
+      bool filtered = false;                  // whether the session receives only the subscribed topics (guarded by the registry mutex)..
+      std::uint64_t last_delivered = 0;       // the sequence number of the last message delivered by the fan-out thread (used only by it)..
+    };
+    using session_registry = std::unordered_map<network::websocket_session *, std::shared_ptr<gui_session>>;
+
+    /**
+     * @brief The point, in the stream of the broadcast messages, at which a session joins it (or changes its subscriptions).
+     */
+    struct session_sync
+    {
+      std::shared_ptr<gui_session> session;
+      std::vector<std::string> frames;                   // the serialized messages bringing the session up to date to this point..
+      bool subscription = false;                         // whether the session changes its subscriptions at this point, rather than joining the stream..
+      std::vector<std::string> subscribed, unsubscribed; // the topics added to, and removed from, the subscriptions of the session..
+      bool unfiltered = false;                           // whether the session receives every topic from this point on..
+    };
+
+    struct subscription_index
+    {
+      std::vector<std::shared_ptr<gui_session>> unfiltered;                                    // the sessions receiving every topic..
+      std::unordered_map<std::string, std::vector<std::shared_ptr<gui_session>>> subscribers; // the sessions subscribed to each topic..
+    };
+    static std::shared_ptr<const subscription_index> index_subscriptions(const session_registry &registry);
+    /**
+     * @brief Adds (or removes) the solvers, sensors and sensor types listed in the message to (or from) the topics of the session.
+     *
+     * Once a session subscribes, it receives the messages with a topic only for its subscribed topics. The changes take effect through a sync marker, right after the catch-up of the newly subscribed solvers, since the session might have missed some of their events.
+     */
+    void subscribe(network::websocket_session &ws, json::json &x, bool sub);
+    /**
+     * @brief Returns the session to receiving every topic, sending it a full snapshot (as at login) through a sync marker.
+     */
+    void subscribe_all(network::websocket_session &ws, json::json &x);
+
+    void broadcast(std::string &&msg, bool to_all = true, std::string &&key = {}, std::vector<std::string> &&topics = {});
+    /**
+     * @brief Queues the given message for the fan-out thread, without recording it.
+     */
+    void enqueue(std::string &&msg, bool to_all = true, std::string &&key = {}, std::vector<std::string> &&topics = {});
+    /**
+     * @brief Returns the key of the updates of the given kind (a tag, e.g. 'v' for the sensor values) of the given item, short enough not to be allocated.
+     */
+    static std::string update_key(const char kind, const void *item)
+    {
+      std::string key(1 + sizeof(item), kind);
+      std::memcpy(&key[1], &item, sizeof(item));
+      return key;
+    }
+
+    std::shared_ptr<gui_session> add_session(network::websocket_session &ws, const std::string &user_id, bool admin, wire_format format, bool compress, bool relay = false);
+    void remove_session(network::websocket_session &ws);
+
+    void send(gui_session &s, const std::string &msg);
+    void send(gui_session &s, const utils::c_ptr<network::message> &msg, std::size_t size);
+    /**
+     * @brief Sends the given broadcast message to the session, in the format of the session.
+     */
+    void send(gui_session &s, const outgoing_message &m);
+    /**
+     * @brief Returns the encoding of the given broadcast message suited to the session, or nullptr for the plain JSON frame.
+     */
+    const frame *select(const gui_session &s, const outgoing_message &m) const;
+    /**
+     * @brief Builds, from the JSON text of the given broadcast message, the encodings needed by the target sessions.
+     */
+    void encode(outgoing_message &m, const std::vector<const std::shared_ptr<gui_session> *> &targets);
+    json::json users_message();
+    json::json sensor_types_message();
+
+    struct cached_response
+    {
+      std::string etag;
+      std::string body;
+    };
+    std::shared_ptr<const cached_response> get_cached(std::shared_ptr<const cached_response> &cache, const std::function<json::json()> &build);
+    void invalidate(std::shared_ptr<const cached_response> &cache);
+    /**
+     * @brief Returns the serialized sensors list, serializing again only the sensors which changed since it was last built.
+     */
+    std::shared_ptr<const cached_response> sensors_response();
+    /**
+     * @brief Marks the entry of the sensor, which has a new value or state, as changed. Must be called while holding the core mutex.
+     */
+    void touch_sensor(const sensor &s);
+    /**
+     * @brief Discards the sensors list, some sensor being created or removed. Must be called while holding the core mutex.
+     */
+    void reset_sensors();
+    void respond(network::request &req, network::response &res, const cached_response &c);
+
+    using sensor_catalog = std::unordered_map<std::string, std::map<std::string, parameter_type>>; // the parameters of each sensor..
+    /**
+     * @brief Returns an immutable snapshot of the sensors, which the read-only handlers use without taking the core mutex.
+     */
+    std::shared_ptr<const sensor_catalog> get_catalog();
+    static std::string etag(const std::string &body);
+
+    /**
+     * @brief Appends to the frames the messages bringing a client up to date: the sensor types, the sensors, the solvers with their graphs and, for the admins, the users.
+     */
+    void snapshot(std::vector<std::string> &frames, bool admin, const std::unordered_map<std::string, std::pair<long, long>> &versions = {});
+    /**
+     * @brief Appends the snapshot to the given frames and hands them to `then`, both while holding the core mutex, so that a session can be synchronized at the point of the snapshot.
+     *
+     * A relay fetches the lists of its primary beforehand, without holding the core mutex, and fetches them again should the stream change them meanwhile.
+     *
+     * @throws upstream_error if a relay cannot fetch the lists of its primary.
+     */
+    void with_snapshot(std::vector<std::string> &&frames, bool admin, const std::unordered_map<std::string, std::pair<long, long>> &versions, lock_site &site, const std::function<void(std::vector<std::string> &&)> &then);
+    void solver_snapshot(std::vector<std::string> &frames, const coco_executor &exec, const std::unordered_map<std::string, std::pair<long, long>> &versions);
+    /**
+     * @brief Appends to the frames the events of the graph the client missed, if they are still available, or the whole graph.
+     */
+    static void graph_snapshot(std::vector<std::string> &frames, graph_model &gr, const std::unordered_map<std::string, std::pair<long, long>> &versions);
+    /**
+     * @brief Queues the point at which the session joins the stream of the broadcast messages. Must be called while holding the core mutex, as the broadcasts are.
+     *
+     * Once the fan-out thread reaches that point it sends the given frames, and the following messages afterwards. The session thus receives neither the messages already reflected by the frames nor the later ones ahead of them.
+     */
+    void sync(const std::shared_ptr<gui_session> &s, std::vector<std::string> &&frames);
+    /**
+     * @brief Queues the given point. A point without frames needs not the core mutex, the changes of a session being queued in the order of its messages.
+     */
+    void sync(std::shared_ptr<session_sync> &&y);
+    void synchronize(session_sync &y);
+    static std::unordered_map<std::string, std::pair<long, long>> parse_versions(json::json &x);
+    /**
+     * @brief Delivers the message to the session, applying the slow consumer policy.
+     *
+     * @return whether the session must be closed, which the fan-out thread does once it has released its locks.
+     */
+    bool deliver(gui_session &s, const outgoing_message &m);
+    void acknowledge(network::websocket_session &ws, std::size_t received);
+    json::json sessions_message();
+
+    graph_model &get_graph(const coco_executor &exec);
+
+    void batch(const coco_executor &exec, json::json &&msg, const std::string_view &kind = {}, const void *item = nullptr);
+    /**
+     * @brief Adds the given serialized, and already applied, solver event to the batch of its solver.
+     *
+     * @param solver the identity of the solver keying its batch.
+     * @param kind the kind of the update, which must outlive the batch (e.g. a literal).
+     */
+    void batch(const void *solver, const std::string &solver_id, std::string &&msg, const std::string_view &kind = {}, const void *item = nullptr);
+    void flush_batch(const void *solver);
+    void flush_batches(bool all);
+
+    /**
+     * @brief The tick and execution updates of a solver not yet sent, conflated until its next window.
+     */
+    struct execution_window
+    {
+      std::chrono::steady_clock::time_point sent; // when the updates were last sent..
+      bool state = false;                         // whether the state of the solver changed (the message is built only when sent)..
+      std::optional<utils::rational> time;        // the latest tick..
+      std::optional<json::json> started, ended;   // the accumulated `start` and `end` messages..
+
+      bool pending() const { return state || time || started || ended; }
+    };
+    /**
+     * @brief Sends the updates of the window right away if the previous ones were sent at least a period ago, otherwise leaves them to the fan-out thread.
+     */
+    void conflate(const coco_executor &exec, execution_window &w);
+    void send_execution(const coco_executor &exec, execution_window &w);
+    void flush_executions();
+
+    void wake_fanout();
+    void fanout();
+
+    /**
+     * @brief A solver of the primary server, as known by a relay.
+     */
+    struct relayed_solver
+    {
+      json::json info;                    // the entry of the solver in the `solvers` message..
+      std::optional<json::json> state;    // the latest `state_changed` message, kept up to date by the execution updates..
+      std::unique_ptr<graph_model> graph; // rebuilt from the graphs of the primary, and versioned by the relay..
+      long epoch = 0, version = 0;        // the version of the graph of the primary the relay is at..
+    };
+    /**
+     * @brief Applies the given message of the primary to the state of the relay and fans it out to the sessions.
+     */
+    void relay_message(std::string &&msg);
+    void relay_event(relayed_solver &slv, json::json &msg);
+    void forget_relayed_solver(relayed_solver &slv);
+    void relay_login(network::websocket_session &ws, json::json &x);
+    /**
+     * @brief The lists of the primary server a relay sends along with its snapshots.
+     */
+    struct relayed_lists
+    {
+      std::shared_ptr<const cached_response> sensor_types, sensors, users; // the users for the admins only..
+    };
+    /**
+     * @brief Fetches the lists of the primary server, if not cached. Must be called without holding the core mutex.
+     *
+     * @throws upstream_error if the primary does not answer with the lists.
+     */
+    relayed_lists fetch_relayed_lists(bool admin);
+    void relayed_snapshot(std::vector<std::string> &frames, const relayed_lists &lists, const std::unordered_map<std::string, std::pair<long, long>> &versions);
+    static void relayed_solver_snapshot(std::vector<std::string> &frames, relayed_solver &slv, const std::unordered_map<std::string, std::pair<long, long>> &versions);
+    /**
+     * @brief Fetches the given list from the primary server. Must be called without holding the core mutex.
+     *
+     * @throws upstream_error if the primary does not answer with the list.
+     */
+    json::json upstream_list(const std::string &target);
 
   private:
     std::unordered_map<network::websocket_session *, std::string> ws_to_user;
     std::unordered_map<std::string, network::websocket_session *> user_to_ws;
+
+    std::mutex sessions_mtx;                          // serializes the writers of the session registry..
+    std::shared_ptr<const session_registry> sessions; // copy-on-write snapshot read by the fan-out thread..
+    std::atomic<std::uint64_t> session_count{0};      // the number of sessions ever opened, numbering them..
+    std::shared_ptr<const subscription_index> subscriptions; // copy-on-write snapshot, rebuilt along with the registry..
+
+    mpsc_queue<outgoing_message> out_queue;    // messages waiting to be sent to the connected sessions..
+    std::uint64_t sequence = 0;                  // the sequence number of the message being fanned out (used only by the fan-out thread)..
+    std::vector<const std::shared_ptr<gui_session> *> fanout_targets; // the sessions receiving the message being fanned out (used only by the fan-out thread)..
+    std::atomic<std::size_t> encoded_sessions{0}; // the number of sessions receiving MessagePack or compressed frames..
+    std::atomic<bool> running{true};
+    std::atomic<bool> fanout_idle{false};
+    std::mutex fanout_mtx; // held by the fan-out thread while it is sending to the sessions of a snapshot..
+    std::recursive_mutex close_mtx; // held by the fan-out thread while it is closing the slow sessions (recursive, as closing a session might call back into its removal)..
+    std::mutex wake_mtx;
+    std::condition_variable wake_cv;
+    std::thread fanout_thread;
+
+    struct solver_batch
+    {
+      std::string solver_id; // serialized..
+      std::chrono::steady_clock::time_point opened;
+      std::vector<std::string> messages; // serialized..
+      std::map<std::pair<std::string_view, const void *>, std::size_t> latest; // the position, within the batch, of the latest update of each item..
+    };
+    void send_batch(solver_batch &b);
+
+    std::atomic<std::chrono::milliseconds::rep> batch_window{COCO_BATCH_WINDOW}; // a zero window disables the batching..
+    std::atomic<std::size_t> batch_size{COCO_BATCH_SIZE};
+    std::mutex batches_mtx;
+    std::unordered_map<const void *, solver_batch> batches; // by solver..
+    std::atomic<bool> batches_pending{false};
+
+    std::unordered_map<const coco_executor *, std::unique_ptr<graph_model>> graphs; // guarded by the core mutex..
+
+    std::atomic<write_durability> durability{write_durability::enqueued};
+    std::mutex values_mtx;
+    std::condition_variable values_cv;
+    std::deque<pending_value> pending_values; // the sensor values waiting to be written..
+    bool writing = true;                      // cleared, under the mutex, to stop the writer thread once the queue is drained..
+    std::thread writer_thread;
+
+    std::atomic<double> execution_rate{COCO_EXECUTION_RATE}; // a zero rate disables the conflation..
+    std::unordered_map<const coco_executor *, execution_window> executions; // guarded by the core mutex..
+    std::atomic<bool> executions_pending{false};
+
+    std::shared_ptr<const cached_response> users_cache, sensor_types_cache, sensors_cache; // the serialized lists, rebuilt on demand after being invalidated..
+    std::atomic<std::uint64_t> invalidations{0};                                           // incremented as a list is invalidated, so that a relay does not cache a list fetched meanwhile..
+    struct sensor_entry
+    {
+      const sensor *sns;
+      std::string body; // the serialized sensor..
+      bool dirty;       // whether the sensor changed since it was serialized..
+    };
+    bool sensor_entries_built = false;                                 // whether the entries reflect the sensors of the database (guarded by the core mutex, as the entries)..
+    std::vector<sensor_entry> sensor_entries;                          // the serialized sensors of the sensors list, in order..
+    std::unordered_map<std::string, std::size_t> sensor_entries_index; // the position of each sensor within the entries..
+    std::vector<std::size_t> dirty_sensor_entries;                     // the positions of the changed entries..
+    std::shared_ptr<const sensor_catalog> catalog;                                        // rebuilt on demand after the sensors change..
+
+    const std::chrono::milliseconds sensor_values_slice = std::chrono::hours{1}; // the initial time span of the sensor values read from the database at once..
+
+    std::mutex principals_mtx;
+    std::unordered_map<std::string, std::shared_ptr<const principal>> principals; // the resolved tokens, until they expire or their user changes..
+    std::uint64_t principals_generation = 0;                                      // incremented as a user changes, so that the tokens resolved meanwhile are not remembered..
+
+    std::mutex recent_values_mtx;
+    std::unordered_map<std::string, std::unique_ptr<sensor_series>> recent_values; // the most recent values of each sensor, answering the queries they cover..
+    std::unordered_map<std::string, std::size_t> recent_values_capacity;         // the number of recent values kept for the sensors of each type..
+
+    router<api_route> api;  // the routes of the REST API..
+    const asset_table assets{"client/dist"}; // the built client, loaded once..
+    server_metrics metrics; // exposed, in the Prometheus text format, through the `/metrics` route..
+
+    /**
+     * @brief The metrics of the listener callbacks, resolved once, rather than looked up on each event.
+     */
+    struct listener_metrics
+    {
+      listener_metrics(server_metrics &m) : new_user(m, "new_user"), updated_user(m, "updated_user"), removed_user(m, "removed_user"), new_sensor_type(m, "new_sensor_type"), updated_sensor_type(m, "updated_sensor_type"), removed_sensor_type(m, "removed_sensor_type"), new_sensor(m, "new_sensor"), updated_sensor(m, "updated_sensor"), removed_sensor(m, "removed_sensor"), new_sensor_value(m, "new_sensor_value"), new_sensor_state(m, "new_sensor_state"), new_solver(m, "new_solver"), removed_solver(m, "removed_solver"), state_changed(m, "state_changed"), flaw_created(m, "flaw_created"), flaw_state_changed(m, "flaw_state_changed"), flaw_cost_changed(m, "flaw_cost_changed"), flaw_position_changed(m, "flaw_position_changed"), current_flaw(m, "current_flaw"), resolver_created(m, "resolver_created"), resolver_state_changed(m, "resolver_state_changed"), current_resolver(m, "current_resolver"), causal_link_added(m, "causal_link_added"), executor_state_changed(m, "executor_state_changed"), tick(m, "tick"), start(m, "start"), end(m, "end") {}
+
+      callback_metrics new_user, updated_user, removed_user, new_sensor_type, updated_sensor_type, removed_sensor_type, new_sensor, updated_sensor, removed_sensor, new_sensor_value, new_sensor_state, new_solver, removed_solver, state_changed, flaw_created, flaw_state_changed, flaw_cost_changed, flaw_position_changed, current_flaw, resolver_created, resolver_state_changed, current_resolver, causal_link_added, executor_state_changed, tick, start, end;
+    };
+    listener_metrics callbacks{metrics};
+    lock_site &relay_site = metrics.lock_sites.get("relay");
+    lock_site &on_ws_message_site = metrics.lock_sites.get("on_ws_message");
+    lock_site &acknowledge_site = metrics.lock_sites.get("acknowledge");
+    std::unordered_map<std::string, counter *> relayed_messages; // the counters of the relayed messages, by type (used only by the relay thread)..
+
+    std::atomic<std::size_t> high_water_mark{COCO_SESSION_HWM};
+    std::atomic<slow_consumer_policy> slow_consumer{slow_consumer_policy::drop};
+    std::atomic<std::size_t> compression_threshold{COCO_COMPRESSION_THRESHOLD};
+
+    const std::chrono::steady_clock::time_point launched = std::chrono::steady_clock::now();
+    std::atomic<bool> ready{true};
+    std::atomic<long long> ready_us{-1}, first_response_us{-1}; // the times, since the launch, to the readiness and to the first response..
+    std::mutex startup_mtx;
+    std::vector<std::pair<std::string, double>> startup_phases; // the startup phases, with their duration in seconds..
+
+    std::shared_ptr<event_log_writer> recorder; // the event log being recorded, if any..
+    std::atomic<bool> guest_logins{false};
+
+    struct upstream_node
+    {
+      std::string host, port;
+      std::string token;
+    };
+    std::optional<upstream_node> upstream;                              // the primary server, if this is a relay..
+    std::map<std::string, relayed_solver> relayed_solvers;              // by serialized solver id, guarded by the core mutex..
+    std::unordered_map<std::string, std::string> relayed_sensor_types; // the serialized type of each sensor, keying the topics (guarded by the core mutex)..
+    std::atomic<std::uint64_t> relayed_list_changes{0};                 // incremented as the stream changes the users, sensor types or sensors, so that the snapshots are not built with older lists..
+    bool relay_synced = false;                                          // whether the snapshot of the primary has been received (used only by the relay thread)..
   };
 } // namespace coco_gui
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace coco::coco_gui
+{
+  enum class event_kind : std::uint8_t
+  {
+    broadcast,    // a message fanned out to the sessions..
+    solver_event, // a solver event, going through the batching of its solver..
+    flush         // the batch of a solver being flushed..
+  };
+
+  /**
+   * @brief An event of the stream feeding the fan-out, as recorded into an event log.
+   */
+  struct event_record
+  {
+    std::chrono::microseconds time; // since the beginning of the recording..
+    event_kind kind;
+    bool to_all = true;
+    std::string solver_id; // the serialized solver id (solver events and flushes only)..
+    std::string key;       // the update key (the kind of update, for solver events)..
+    std::uint64_t item = 0; // the identity of the updated item (solver events only)..
+    std::vector<std::string> topics;
+    std::string payload;
+  };
+
+  /**
+   * @brief An append-only writer of event logs.
+   *
+   * Records are varint-framed and buffered in memory, a writer thread taking the buffer once it grows large enough (or once a second) and writing it to the file, so that recording never blocks the listener callbacks on the disk.
+   */
+  class event_log_writer
+  {
+  public:
+    event_log_writer(const std::string &path);
+    event_log_writer(const event_log_writer &) = delete;
+    event_log_writer &operator=(const event_log_writer &) = delete;
+    ~event_log_writer();
+
+    void write(event_kind kind, const std::string &payload, bool to_all = true, const std::string &key = {}, const std::vector<std::string> &topics = {}, const std::string &solver_id = {}, std::uint64_t item = 0);
+    /**
+     * @brief Waits for the records written so far to reach the file.
+     */
+    void flush();
+
+  private:
+    void run();
+
+  private:
+    std::mutex mtx;
+    std::condition_variable wake_cv, flushed_cv;
+    std::ofstream out; // used only by the writer thread, once constructed..
+    std::string buf;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::microseconds last{0};
+    std::uint64_t flushes_requested = 0, flushes_done = 0;
+    bool stopping = false;
+    std::thread writer;
+  };
+
+  /**
+   * @brief A sequential reader of event logs.
+   */
+  class event_log_reader
+  {
+  public:
+    event_log_reader(const std::string &path);
+
+    /**
+     * @brief Reads the next record of the log.
+     *
+     * @return false if the log is over (a truncated last record, as left by a crash, is ignored).
+     */
+    bool next(event_record &r);
+
+  private:
+    bool read_varint(std::uint64_t &v);
+    bool read_string(std::string &s);
+
+  private:
+    std::ifstream in;
+    std::chrono::microseconds last{0};
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "json_writer.h"
+#include <mutex>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief The causal graph of a solver, kept up to date from the solver events.
+   *
+   * Every applied event increments the version of the graph and is recorded into a bounded log, so that a client which already knows a version of the graph can be brought up to date through the events it missed. The full graph is serialized at most once per version.
+   */
+  class graph_model
+  {
+  public:
+    graph_model(const json::json &solver_id, json::json graph, const std::size_t max_deltas = COCO_GRAPH_DELTAS);
+
+    const std::string &get_solver_id() const { return s_solver_id; }
+    long get_epoch() const { return epoch; }
+    long get_version();
+
+    /**
+     * @brief Applies a solver event (a `flaw_*`, `resolver_*`, `current_*` or `causal_link_added` message) to the graph and stamps it with the new version of the graph.
+     *
+     * @param msg the event message.
+     * @return std::string the serialized, stamped, event.
+     */
+    std::string apply(json::json &msg);
+
+    /**
+     * @brief Returns the serialized `graph` message of the current version of the graph.
+     */
+    std::string snapshot();
+
+    /**
+     * @brief Returns the serialized `batch` message with the events following the given version of the graph.
+     *
+     * @return std::optional<std::string> the message (empty if there is nothing to send) or nothing if the events are no longer available.
+     */
+    std::optional<std::string> deltas(const long epoch, const long version);
+
+  private:
+    static void add(std::vector<json::json> &items, std::unordered_map<std::string, std::size_t> &index, json::json &msg);
+    static void update(std::vector<json::json> &items, std::unordered_map<std::string, std::size_t> &index, json::json &msg);
+    static void merge(json::json &item, json::json &msg);
+
+  private:
+    std::mutex mtx;
+    const json::json solver_id;
+    const std::string s_solver_id; // the serialized solver id..
+    const long epoch; // distinguishes the versions of this graph from those of graphs created by previous runs of the server..
+    long version = 0;
+    std::vector<json::json> flaws, resolvers;
+    std::unordered_map<std::string, std::size_t> flaws_index, resolvers_index;
+    json::json extra; // the other members of the graph (e.g., the current flaw and resolver)..
+    const std::size_t max_deltas;
+    std::deque<std::pair<long, std::string>> log; // the last applied events, serialized, with the version they produced..
+    std::string c_snapshot;
+    long c_snapshot_version = -1;
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "json.h"
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief A streaming JSON writer, appending the serialized members directly into a single output buffer.
+   *
+   * The buffer is reserved upfront and released, once complete, to become the body of the outgoing message, so that no intermediate tree is built and the text is never copied.
+   */
+  class json_writer
+  {
+  public:
+    json_writer(const std::size_t capacity = 256) { buf.reserve(capacity); }
+
+    json_writer &begin_object()
+    {
+      separate();
+      buf += '{';
+      first = true;
+      return *this;
+    }
+    json_writer &end_object()
+    {
+      buf += '}';
+      first = false;
+      return *this;
+    }
+    json_writer &begin_array()
+    {
+      separate();
+      buf += '[';
+      first = true;
+      return *this;
+    }
+    json_writer &end_array()
+    {
+      buf += ']';
+      first = false;
+      return *this;
+    }
+
+    json_writer &key(const std::string_view &k)
+    {
+      separate();
+      write_string(k);
+      buf += ':';
+      first = true; // the value follows the key without a separator..
+      return *this;
+    }
+
+    json_writer &value(const std::string_view &v)
+    {
+      separate();
+      write_string(v);
+      return *this;
+    }
+    json_writer &value(const std::string &v) { return value(std::string_view(v)); }
+    json_writer &value(const char *v) { return value(std::string_view(v)); }
+    json_writer &value(const bool v)
+    {
+      separate();
+      buf += v ? "true" : "false";
+      return *this;
+    }
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    json_writer &value(const T v)
+    {
+      separate();
+      char tmp[24];
+      buf.append(tmp, std::to_chars(tmp, tmp + sizeof(tmp), v).ptr);
+      return *this;
+    }
+    json_writer &value(const double v)
+    {
+      separate();
+      if (!std::isfinite(v))
+        buf += "null";
+      else
+      {
+        char tmp[32];
+        buf.append(tmp, std::to_chars(tmp, tmp + sizeof(tmp), v).ptr);
+      }
+      return *this;
+    }
+    /**
+     * @brief Writes a JSON value which is already available as a tree (e.g., a value coming from the core).
+     */
+    json_writer &value(const json::json &v)
+    {
+      separate();
+      buf += v.to_string();
+      return *this;
+    }
+    /**
+     * @brief Writes an already serialized JSON value, as it is.
+     */
+    json_writer &raw(const std::string_view &v)
+    {
+      separate();
+      buf += v;
+      return *this;
+    }
+
+    std::size_t size() const { return buf.size(); }
+    std::string release() { return std::move(buf); }
+
+  private:
+    void separate()
+    {
+      if (!first)
+        buf += ',';
+      first = false;
+    }
+
+    void write_string(const std::string_view &s)
+    {
+      static constexpr char hex[] = "0123456789abcdef";
+      buf += '"';
+      std::size_t start = 0;
+      for (std::size_t i = 0; i < s.size(); ++i)
+      {
+        const unsigned char c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+          continue;
+        buf.append(s.data() + start, i - start); // we copy the plain characters in runs..
+        switch (c)
+        {
+        case '"':
+          buf += "\\\"";
+          break;
+        case '\\':
+          buf += "\\\\";
+          break;
+        case '\n':
+          buf += "\\n";
+          break;
+        case '\r':
+          buf += "\\r";
+          break;
+        case '\t':
+          buf += "\\t";
+          break;
+        default:
+          buf += "\\u00";
+          buf += hex[c >> 4];
+          buf += hex[c & 0xF];
+        }
+        start = i + 1;
+      }
+      buf.append(s.data() + start, s.size() - start);
+      buf += '"';
+    }
+
+  private:
+    std::string buf;
+    bool first = true; // whether the next value is the first of its container (or follows a key)..
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace coco::coco_gui
+{
+  class counter
+  {
+  public:
+    void inc(const std::uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<std::uint64_t> value{0};
+  };
+
+  /**
+   * @brief A lock-free histogram with logarithmic buckets, the i-th bucket counting the values up to 2^i.
+   *
+   * Recording a value takes a couple of relaxed atomic increments, so histograms can be left on the hot paths.
+   */
+  class histogram
+  {
+  public:
+    static constexpr std::size_t n_buckets = 40;
+
+    void observe(const std::uint64_t v)
+    {
+      const std::size_t i = bucket(v);
+      buckets[i < n_buckets ? i : n_buckets - 1].fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(v, std::memory_order_relaxed);
+    }
+    void observe(const std::chrono::steady_clock::duration &d) { observe(std::chrono::duration_cast<std::chrono::microseconds>(d).count()); }
+
+    /**
+     * @brief Appends the histogram to the output, in the Prometheus text format.
+     *
+     * All the buckets in the [first, last) range are written, even the empty ones, the values of the buckets below the range being counted in its first one, and those above it only in the `+Inf` one.
+     *
+     * @param scale the factor converting the recorded values into the exported unit (e.g., 1e-6 for durations recorded in microseconds and exported in seconds).
+     */
+    void write(std::string &out, const std::string &name, const std::string &labels, const double scale = 1, const std::size_t first = 0, const std::size_t last = n_buckets) const;
+
+  private:
+    /**
+     * @brief Returns the smallest i such that v <= 2^i.
+     */
+    static std::size_t bucket(std::uint64_t v)
+    {
+      if (v <= 1)
+        return 0;
+#if defined(__GNUC__) || defined(__clang__)
+      return 64 - __builtin_clzll(v - 1);
+#else
+      std::size_t i = 0; // the number of significant bits of v - 1..
+      for (--v; v; v >>= 1)
+        ++i;
+      return i;
+#endif
+    }
+
+    std::atomic<std::uint64_t> buckets[n_buckets] = {};
+    std::atomic<std::uint64_t> sum{0};
+  };
+
+  /**
+   * @brief A set of metrics of the same kind, distinguished by the value of a label.
+   *
+   * The members are created on first use and never removed, so the returned references stay valid.
+   */
+  template <typename T>
+  class family
+  {
+  public:
+    T &get(const std::string_view &label)
+    {
+      {
+        std::shared_lock<std::shared_mutex> _(mtx);
+        if (auto it = members.find(label); it != members.end())
+          return *it->second;
+      }
+      std::unique_lock<std::shared_mutex> _(mtx);
+      auto it = members.find(label);
+      if (it == members.end())
+        it = members.emplace(std::string(label), std::make_unique<T>()).first;
+      return *it->second;
+    }
+
+    template <typename F>
+    void for_each(F f) const
+    {
+      std::shared_lock<std::shared_mutex> _(mtx);
+      for (const auto &[label, m] : members)
+        f(label, *m);
+    }
+
+  private:
+    mutable std::shared_mutex mtx;
+    std::map<std::string, std::unique_ptr<T>, std::less<>> members;
+  };
+
+  struct route_metrics
+  {
+    histogram latency, request_size, response_size;
+  };
+
+  struct lock_site
+  {
+    histogram wait, hold;
+  };
+
+  /**
+   * @brief The metrics of the GUI server.
+   */
+  class server_metrics
+  {
+  public:
+    family<route_metrics> routes;  // by route..
+    family<lock_site> lock_sites;  // by function taking the core mutex..
+    family<counter> messages;      // by type of the solver and sensor events..
+    histogram fanout;              // the time taken to deliver each message to the sessions..
+    histogram write_delay;         // the time the sensor values waited to be written..
+    counter broadcasts, broadcast_bytes;
+
+    /**
+     * @brief Appends the metrics to the output, in the Prometheus text format.
+     */
+    void write(std::string &out) const;
+  };
+
+  /**
+   * @brief The lock site and the message counter of a listener callback, resolved once so that the events need not look them up.
+   */
+  struct callback_metrics
+  {
+    callback_metrics(server_metrics &m, const std::string_view &name) : site(m.lock_sites.get(name)), messages(m.messages.get(name)) {}
+
+    lock_site &site;
+    counter &messages;
+  };
+
+  /**
+   * @brief An opt-in profiler of the core mutex, attributing each acquisition to the stack of the acquisitions its thread already holds.
+   *
+   * While active, the samples are appended to per-thread buffers and merged, by a background thread, into totals by stack of sites, so that recursive acquisitions (e.g., a listener broadcasting, or a handler authorizing) show up under their callers.
+   */
+  class lock_profiler
+  {
+  public:
+    static constexpr std::size_t max_depth = 8; // the deeper acquisitions are attributed to their eighth ancestor..
+
+    enum class metric
+    {
+      wait,
+      hold,
+      count
+    };
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    static void start();
+    static void stop();
+    static void reset();
+
+    static void enter(const lock_site &site);
+    static void exit(const std::chrono::steady_clock::duration &wait, const std::chrono::steady_clock::duration &hold);
+
+    /**
+     * @brief Appends the collected profile to the output, in the folded stacks format of the flame graph tools (i.e., a `site;site;... value` line per stack).
+     *
+     * Hold times are exclusive of the nested acquisitions, so that the flame graph adds them up to the inclusive time of each frame.
+     */
+    static void write(std::string &out, const family<lock_site> &sites, const metric m);
+
+  private:
+    inline static std::atomic<bool> active{false};
+  };
+
+  /**
+   * @brief A scoped lock of the core mutex which records, into the given site, how long it waited for the mutex and how long it held it.
+   */
+  class core_lock
+  {
+  public:
+    core_lock(std::recursive_mutex &mtx, lock_site &site) : mtx(mtx), site(site), profiled(lock_profiler::enabled())
+    {
+      if (profiled)
+        lock_profiler::enter(site);
+      const auto start = std::chrono::steady_clock::now();
+      mtx.lock();
+      acquired = std::chrono::steady_clock::now();
+      waited = acquired - start;
+      site.wait.observe(waited);
+    }
+    core_lock(const core_lock &) = delete;
+    core_lock &operator=(const core_lock &) = delete;
+    ~core_lock()
+    {
+      const auto held = std::chrono::steady_clock::now() - acquired;
+      mtx.unlock();
+      site.hold.observe(held);
+      if (profiled)
+        lock_profiler::exit(waited, held);
+    }
+
+  private:
+    std::recursive_mutex &mtx;
+    lock_site &site;
+    const bool profiled;
+    std::chrono::steady_clock::time_point acquired;
+    std::chrono::steady_clock::duration waited;
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief An unbounded lock-free multi-producer single-consumer queue.
+   *
+   * Any number of threads may `push` concurrently, each push being a single atomic exchange. Only one thread may `pop`.
+   */
+  template <typename T>
+  class mpsc_queue
+  {
+    struct node
+    {
+      std::atomic<node *> next{nullptr};
+      std::optional<T> value;
+    };
+
+  public:
+    mpsc_queue() : head(new node), tail(head.load(std::memory_order_relaxed)) {}
+    mpsc_queue(const mpsc_queue &) = delete;
+    mpsc_queue &operator=(const mpsc_queue &) = delete;
+    ~mpsc_queue()
+    {
+      while (pop())
+        ;
+      delete tail;
+    }
+
+    void push(T &&value)
+    {
+      node *n = new node;
+      n->value.emplace(std::move(value));
+      node *prev = head.exchange(n);
+      prev->next.store(n);
+    }
+
+    std::optional<T> pop()
+    {
+      node *next = tail->next.load();
+      if (!next)
+        return std::nullopt;
+      std::optional<T> value = std::move(next->value);
+      next->value.reset();
+      delete tail;
+      tail = next;
+      return value;
+    }
+
+    bool empty() const { return !tail->next.load(); }
+
+  private:
+    std::atomic<node *> head;
+    node *tail;
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "json.h"
+#include <string>
+#include <string_view>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief Appends the MessagePack encoding of the given JSON value to the output buffer.
+   *
+   * Numbers with an integral value are encoded as integers, the other ones as 64-bit floats. Every container and string takes the smallest header that fits its size.
+   */
+  void write_msgpack(std::string &out, json::json &value);
+
+  /**
+   * @brief Returns the MessagePack encoding of the given JSON value.
+   */
+  std::string to_msgpack(json::json &value);
+
+  /**
+   * @brief Appends the MessagePack encoding of the given JSON text to the output buffer.
+   *
+   * The text, as produced by the `json_writer` or by `json::to_string`, is transcoded in a single pass, without building the tree, following the same rules as for the trees.
+   *
+   * @throws std::invalid_argument if the text is not valid JSON.
+   */
+  void write_msgpack(std::string &out, const std::string_view &text);
+
+  /**
+   * @brief Returns the MessagePack encoding of the given JSON text.
+   */
+  std::string to_msgpack(const std::string_view &text);
+} // namespace coco::coco_gui
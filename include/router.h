@@ -0,0 +1,182 @@
+#pragma once
+
+#include <boost/beast/http/verb.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief The parameters extracted from a path, in order of appearance. They refer to the matched path.
+   */
+  class path_params
+  {
+  public:
+    std::string_view operator[](const size_t i) const { return params[i]; }
+    size_t size() const { return n; }
+
+    bool push_back(const std::string_view &param)
+    {
+      if (n == params.size())
+        return false;
+      params[n++] = param;
+      return true;
+    }
+    void pop_back() { n--; }
+
+  private:
+    std::array<std::string_view, 4> params;
+    size_t n = 0;
+  };
+
+  /**
+   * @brief The parameters of a query string, looked up in place without allocating.
+   *
+   * Values are not percent-decoded.
+   */
+  class query_params
+  {
+  public:
+    query_params(const std::string_view &query) : query(query) {}
+
+    std::optional<std::string_view> get(const std::string_view &key) const
+    {
+      size_t pos = 0;
+      while (pos < query.size())
+      {
+        size_t end = query.find('&', pos);
+        if (end == std::string_view::npos)
+          end = query.size();
+        const auto param = query.substr(pos, end - pos);
+        const auto eq = param.find('=');
+        if (param.substr(0, eq) == key)
+          return eq == std::string_view::npos ? std::string_view() : param.substr(eq + 1);
+        pos = end + 1;
+      }
+      return std::nullopt;
+    }
+
+    bool has(const std::string_view &key) const { return get(key).has_value(); }
+
+    template <typename T>
+    std::optional<T> get_number(const std::string_view &key) const
+    {
+      if (auto str = get(key))
+      {
+        T value;
+        if (auto [ptr, ec] = std::from_chars(str->data(), str->data() + str->size(), value); ec == std::errc() && ptr == str->data() + str->size())
+          return value;
+      }
+      return std::nullopt;
+    }
+
+  private:
+    const std::string_view query;
+  };
+
+  inline std::string_view path_of(const std::string_view &target) { return target.substr(0, target.find('?')); }
+  inline std::string_view query_of(const std::string_view &target)
+  {
+    const auto q = target.find('?');
+    return q == std::string_view::npos ? std::string_view() : target.substr(q + 1);
+  }
+
+  /**
+   * @brief A route table, organized as a trie over the path segments.
+   *
+   * Patterns are made of static segments and of parameter segments, starting with ':', which match any segment and are extracted into the path parameters. Static segments are preferred over parameters.
+   */
+  template <typename Handler>
+  class router
+  {
+    struct node
+    {
+      std::vector<std::pair<std::string, std::unique_ptr<node>>> children; // the static segments..
+      std::unique_ptr<node> param;                                         // the parameter segment..
+      std::vector<std::pair<boost::beast::http::verb, Handler>> handlers;
+    };
+
+  public:
+    void add(const boost::beast::http::verb verb, const std::string_view &pattern, Handler &&handler)
+    {
+      node *n = &root;
+      for (size_t pos = 1; pos <= pattern.size();)
+      {
+        size_t end = pattern.find('/', pos);
+        if (end == std::string_view::npos)
+          end = pattern.size();
+        const auto segment = pattern.substr(pos, end - pos);
+        if (!segment.empty() && segment.front() == ':')
+        {
+          if (!n->param)
+            n->param = std::make_unique<node>();
+          n = n->param.get();
+        }
+        else
+        {
+          auto it = std::find_if(n->children.begin(), n->children.end(), [&segment](const auto &c)
+                                 { return c.first == segment; });
+          if (it == n->children.end())
+            it = n->children.emplace(n->children.end(), std::string(segment), std::make_unique<node>());
+          n = it->second.get();
+        }
+        pos = end + 1;
+      }
+      n->handlers.emplace_back(verb, std::move(handler));
+    }
+
+    /**
+     * @brief Matches the given path, without the query string, against the routes.
+     *
+     * @return const Handler* the handler of the matching route, or nullptr if no route matches.
+     */
+    const Handler *match(const boost::beast::http::verb verb, const std::string_view &path, path_params &params) const
+    {
+      if (path.empty() || path.front() != '/')
+        return nullptr;
+      return match(root, verb, path.substr(1), params);
+    }
+
+  private:
+    const Handler *match(const node &n, const boost::beast::http::verb verb, const std::string_view &path, path_params &params) const
+    {
+      const auto end = path.find('/');
+      const auto segment = path.substr(0, end);
+      const bool last = end == std::string_view::npos;
+      const auto rest = last ? std::string_view() : path.substr(end + 1);
+
+      for (const auto &[s, child] : n.children)
+        if (s == segment)
+        {
+          if (auto h = last ? find(*child, verb) : match(*child, verb, rest, params))
+            return h;
+          break;
+        }
+
+      if (n.param && !segment.empty() && params.push_back(segment))
+      {
+        if (auto h = last ? find(*n.param, verb) : match(*n.param, verb, rest, params))
+          return h;
+        params.pop_back();
+      }
+      return nullptr;
+    }
+
+    static const Handler *find(const node &n, const boost::beast::http::verb verb)
+    {
+      for (const auto &[v, h] : n.handlers)
+        if (v == verb)
+          return &h;
+      return nullptr;
+    }
+
+  private:
+    node root;
+  };
+} // namespace coco::coco_gui
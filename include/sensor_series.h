@@ -0,0 +1,123 @@
+#pragma once
+
+#include "coco_db.h"
+#include <vector>
+#include <functional>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief The values of a sensor, stored by columns.
+   *
+   * The timestamps and the numeric parameters are stored into contiguous arrays, so that they can be reduced by tight loops, while the other parameters (booleans, symbols and strings) are stored as JSON values. Missing numeric values are stored as NaNs. The integer parameters are stored as doubles too (which hold them exactly up to 2^53), and given back as integers.
+   *
+   * A series with a capacity keeps only the most recent values: when it is full, its oldest half is discarded, so that the columns stay contiguous and appending stays constant time on average.
+   */
+  class sensor_series
+  {
+    struct column
+    {
+      std::string name;
+      bool numeric;
+      bool integer;
+      std::vector<double> numbers;
+      std::vector<json::json> values;
+    };
+
+  public:
+    sensor_series(const std::map<std::string, parameter_type> &parameters, const size_t capacity = 0);
+
+    size_t size() const { return timestamps.size(); }
+    bool empty() const { return timestamps.empty(); }
+    long front_timestamp() const { return timestamps.front(); }
+    long back_timestamp() const { return timestamps.back(); }
+
+    /**
+     * @brief Appends a value, as returned by the database (i.e., an object with a `timestamp` and a `value`), to the series.
+     *
+     * The values must be appended in increasing order of timestamp.
+     */
+    void push_back(json::json &value);
+    /**
+     * @brief Appends the value of the parameters at the given timestamp to the series.
+     */
+    void push_back(const long timestamp, json::json &value);
+
+    /**
+     * @brief Returns a copy of the values within the [from, to] interval, so that they can be iterated without keeping the series from growing.
+     */
+    sensor_series range(const long from, const long to) const;
+
+    /**
+     * @brief Calls the given function, in order, on the values within the [from, to] interval, until the function returns false.
+     *
+     * The values are built in the same form they are returned by the database.
+     *
+     * @return bool false if the function stopped the iteration.
+     */
+    bool for_each(const long from, const long to, const std::function<bool(json::json &)> &f) const;
+
+    /**
+     * @brief Reduces the values within the [from, to) interval into buckets of the given duration.
+     *
+     * Each non-empty bucket produces a value whose timestamp is the one of its last value. Numeric parameters are reduced to their average, with their minimum and maximum in the `min` and `max` members (integers for the integer parameters), while the other parameters take the last value of the bucket.
+     *
+     * @return json::json the array of the reduced values.
+     */
+    json::json downsample(const long from, const long to, const long bucket) const;
+
+  private:
+    /**
+     * @brief Creates an empty series with the columns of the given ones.
+     */
+    sensor_series(const std::vector<column> &layout, const size_t capacity);
+
+  private:
+    const size_t capacity; // the maximum number of values (zero for unbounded series)..
+    std::vector<long> timestamps;
+    std::vector<column> columns;
+  };
+
+  /**
+   * @brief Reduces the values of a sensor into buckets as they come, as `sensor_series::downsample` does, holding only the running reduction of the bucket being filled.
+   *
+   * The values read from the database are thus reduced slice by slice, however long the interval, without being collected first.
+   */
+  class sensor_downsampler
+  {
+    struct accumulator
+    {
+      std::string name;
+      bool numeric;
+      bool integer;
+      double min, max, sum;
+      size_t count;
+      json::json last; // the last value of the bucket, for the non-numeric parameters..
+    };
+
+  public:
+    sensor_downsampler(const std::map<std::string, parameter_type> &parameters, const long from, const long to, const long bucket);
+
+    /**
+     * @brief Adds a value, as returned by the database, to its bucket. The values outside the [from, to) interval are ignored.
+     *
+     * The values must be added in increasing order of timestamp.
+     */
+    void push_back(json::json &value);
+    /**
+     * @brief Closes the last bucket and returns the array of the reduced values.
+     */
+    json::json finish();
+
+  private:
+    void flush();
+
+  private:
+    const long from, to, bucket;
+    long b_from = 0;  // the start of the bucket being filled..
+    long last = 0;    // the timestamp of the last value of that bucket..
+    size_t count = 0; // the number of values of that bucket..
+    std::vector<accumulator> accumulators;
+    json::json values; // the reduced values of the closed buckets..
+  };
+} // namespace coco::coco_gui
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace coco::coco_gui
+{
+  /**
+   * @brief The primary server could not be reached, or it did not answer as expected.
+   */
+  class upstream_error : public std::runtime_error
+  {
+  public:
+    upstream_error(const std::string &what) : std::runtime_error(what) {}
+  };
+
+  constexpr std::chrono::milliseconds upstream_timeout{COCO_UPSTREAM_TIMEOUT}; // the time the primary has to accept a connection, to answer a request or, on the stream, to answer a ping..
+
+  /**
+   * @brief A blocking connection to the `/coco` stream of a primary server, through which a relay receives the messages it serves to its own clients.
+   *
+   * The operations fail, with an `upstream_error`, once the primary has been silent for longer than the `upstream_timeout`, the link pinging it as the stream goes idle.
+   */
+  class upstream_link
+  {
+  public:
+    upstream_link(const std::string &host, const std::string &port);
+    ~upstream_link();
+
+    void write(const std::string &msg);
+    /**
+     * @brief Waits for the next message of the stream.
+     */
+    std::string read();
+
+  private:
+    boost::asio::io_context ioc;
+    boost::beast::websocket::stream<boost::beast::tcp_stream> ws;
+    boost::beast::flat_buffer buffer;
+  };
+
+  struct upstream_response
+  {
+    unsigned status;
+    std::string etag;
+    std::string body;
+  };
+
+  /**
+   * @brief Sends a `GET` request, on behalf of the given token, to the primary server.
+   *
+   * @param etag the validator of the representation already known, if any, which the primary answers with a 304 if still current.
+   * @throws upstream_error if the primary cannot be reached, or does not answer within the `upstream_timeout`.
+   */
+  upstream_response upstream_get(const std::string &host, const std::string &port, const std::string &target, const std::string &token, const std::string &etag = {});
+} // namespace coco::coco_gui
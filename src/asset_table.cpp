@@ -0,0 +1,130 @@
+#include "asset_table.h"
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+namespace coco::coco_gui
+{
+    static std::string read_file(const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    static std::string content_type(const std::string &ext)
+    {
+        static const std::unordered_map<std::string, std::string> types{{".html", "text/html; charset=utf-8"}, {".js", "text/javascript; charset=utf-8"}, {".mjs", "text/javascript; charset=utf-8"}, {".css", "text/css; charset=utf-8"}, {".json", "application/json"}, {".map", "application/json"}, {".svg", "image/svg+xml"}, {".ico", "image/x-icon"}, {".png", "image/png"}, {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"}, {".gif", "image/gif"}, {".webp", "image/webp"}, {".woff", "font/woff"}, {".woff2", "font/woff2"}, {".ttf", "font/ttf"}, {".eot", "application/vnd.ms-fontobject"}, {".txt", "text/plain; charset=utf-8"}};
+        if (auto it = types.find(ext); it != types.end())
+            return it->second;
+        return "application/octet-stream";
+    }
+
+    /**
+     * @brief Whether compressing the content of the given type is worth it (the images, but icons and SVGs, and the fonts are already compressed).
+     */
+    static bool compressible(const std::string &type) { return type.rfind("text/", 0) == 0 || type == "application/json" || type == "image/svg+xml" || type == "image/x-icon" || type == "font/ttf" || type == "application/vnd.ms-fontobject"; }
+
+    static std::uint32_t crc32(const std::string &data)
+    {
+        static const auto table = []()
+        {
+            std::array<std::uint32_t, 256> t;
+            for (std::uint32_t i = 0; i < 256; ++i)
+            {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        std::uint32_t c = 0xFFFFFFFF;
+        for (const auto &b : data)
+            c = table[(c ^ static_cast<unsigned char>(b)) & 0xFF] ^ (c >> 8);
+        return c ^ 0xFFFFFFFF;
+    }
+
+    /**
+     * @brief Compresses the given content into a gzip member, with the best compression, since it is done only once.
+     */
+    static std::string gzip(const std::string &data)
+    {
+        boost::beast::zlib::deflate_stream ds;
+        ds.reset(9, 15, 9, boost::beast::zlib::Strategy::normal);
+
+        std::string out(10 + ds.upper_bound(data.size()) + 8, '\0');
+        const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 2, '\xff'}; // deflate, no name, no time, best compression, unknown OS..
+        std::copy(header, header + sizeof(header), out.begin());
+        boost::beast::zlib::z_params zs;
+        zs.next_in = data.data();
+        zs.avail_in = data.size();
+        zs.next_out = &out[10];
+        zs.avail_out = out.size() - 18;
+        boost::system::error_code ec;
+        ds.write(zs, boost::beast::zlib::Flush::finish, ec);
+        out.resize(10 + zs.total_out);
+        for (const auto v : {crc32(data), static_cast<std::uint32_t>(data.size())}) // the trailer is little-endian..
+            for (int i = 0; i < 4; ++i)
+                out += static_cast<char>((v >> (8 * i)) & 0xFF);
+        return out;
+    }
+
+    static std::string etag(const std::string &body)
+    { // a 64-bit FNV-1a hash of the body..
+        std::uint64_t h = 14695981039346656037ull;
+        for (const auto &c : body)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        std::stringstream ss;
+        ss << '"' << std::hex << std::setw(16) << std::setfill('0') << h << '"';
+        return ss.str();
+    }
+
+    asset_table::asset_table(const std::filesystem::path &root)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (!it->is_regular_file())
+                continue;
+            const auto &path = it->path();
+            const auto ext = path.extension().string();
+            if (ext == ".gz" || ext == ".br") // the variants provided by the build are taken along with their asset..
+                continue;
+
+            asset a;
+            a.content_type = content_type(ext);
+            a.body = read_file(path);
+            a.etag = etag(a.body);
+            const auto rel = std::filesystem::relative(path, root).generic_string();
+            a.immutable = rel.rfind("assets/", 0) == 0; // the bundler names the assets after the hash of their content..
+            if (compressible(a.content_type))
+            {
+                if (auto gz = std::filesystem::path(path.string() + ".gz"); std::filesystem::is_regular_file(gz))
+                    a.gzip = read_file(gz);
+                else
+                    a.gzip = gzip(a.body);
+                if (auto br = std::filesystem::path(path.string() + ".br"); std::filesystem::is_regular_file(br))
+                    a.brotli = read_file(br);
+                if (a.gzip.size() >= a.body.size())
+                    a.gzip.clear();
+                if (a.brotli.size() >= a.body.size())
+                    a.brotli.clear();
+            }
+            assets.emplace('/' + rel, std::move(a));
+        }
+    }
+
+    const asset_table::asset *asset_table::find(const std::string_view &path) const
+    {
+        if (auto it = assets.find(path); it != assets.end())
+            return &it->second;
+        return nullptr;
+    }
+} // namespace coco::coco_gui
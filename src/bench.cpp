@@ -0,0 +1,503 @@
+#include "coco_gui.h"
+#include "coco_db.h"
+#include "graph_model.h"
+#include "sensor_series.h"
+#include "json_writer.h"
+#include "msgpack.h"
+#include "router.h"
+#include "mpsc_queue.h"
+#include "metrics.h"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace coco::coco_gui;
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+
+static std::string filter;                   // only the benchmarks whose name contains the filter are run..
+static unsigned short next_port = 18080;     // the in-process servers listen on the loopback interface, each on its own port..
+
+static bool selected(const std::string &name) { return filter.empty() || name.find(filter) != std::string::npos; }
+
+/**
+ * @brief Runs the given function repeatedly, doubling the number of iterations until the run takes at least the minimum time, and reports the time per iteration.
+ *
+ * The function takes the number of iterations to run, so that the setup can be kept out of the measured loop.
+ */
+static void bench(const std::string &name, const std::function<void(std::size_t)> &f, const std::chrono::milliseconds &min_time = std::chrono::milliseconds(500))
+{
+    if (!selected(name))
+        return;
+
+    f(1); // warm up..
+    for (std::size_t n = 1;; n *= 2)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f(n);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed >= min_time || n >= (std::size_t(1) << 40))
+        {
+            const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / n;
+            std::cout << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed << std::setprecision(1) << ns << " ns/op" << std::setw(14) << n << " iterations" << std::endl;
+            return;
+        }
+    }
+}
+
+template <typename T>
+static void do_not_optimize(const T &v) { asm volatile("" : : "r,m"(v) : "memory"); }
+
+static json::json flaw(const std::size_t i)
+{
+    json::json f{{"type", "flaw_created"}, {"solver_id", 1L}, {"id", static_cast<long>(i)}, {"label", "φ" + std::to_string(i)}, {"state", "active"}, {"cost", 1.5}, {"pos", 0L}};
+    json::json causes(json::json_type::array);
+    if (i)
+        causes.push_back(static_cast<long>(i - 1));
+    f["causes"] = std::move(causes);
+    return f;
+}
+
+static json::json graph(const std::size_t n_flaws)
+{
+    json::json g{{"type", "graph"}, {"solver_id", 1L}};
+    json::json flaws(json::json_type::array), resolvers(json::json_type::array);
+    for (std::size_t i = 0; i < n_flaws; ++i)
+    {
+        flaws.push_back(flaw(i));
+        resolvers.push_back({{"id", static_cast<long>(n_flaws + i)}, {"effect", static_cast<long>(i)}, {"label", "ρ" + std::to_string(i)}, {"state", "inactive"}, {"cost", 0.5}});
+    }
+    g["flaws"] = std::move(flaws);
+    g["resolvers"] = std::move(resolvers);
+    return g;
+}
+
+static void bench_messages()
+{
+    json::json value{{"temperature", 21.5}, {"humidity", 40L}, {"status", "ok"}};
+
+    bench("sensor_value_message/json_dom", [&value](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+            {
+                auto msg = json::json{{"type", "new_sensor_value"}, {"sensor", "sensor_0123456789"}, {"timestamp", 1700000000L}, {"value", value}}.to_string();
+                do_not_optimize(msg);
+            } });
+    bench("sensor_value_message/json_writer", [&value](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+            {
+                json_writer w;
+                w.begin_object().key("type").value("new_sensor_value").key("sensor").value("sensor_0123456789").key("timestamp").value(1700000000L).key("value").value(value).end_object();
+                auto msg = w.release();
+                do_not_optimize(msg);
+            } });
+
+    for (const std::size_t n_flaws : {100, 1000})
+    {
+        auto g = graph(n_flaws);
+        bench("graph_message/" + std::to_string(n_flaws) + "/to_string", [&g](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto msg = g.to_string();
+                    do_not_optimize(msg);
+                } });
+        bench("graph_message/" + std::to_string(n_flaws) + "/msgpack", [&g](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto msg = to_msgpack(g);
+                    do_not_optimize(msg);
+                } });
+    }
+}
+
+static void bench_graph_model()
+{
+    for (const std::size_t n_flaws : {100, 1000, 10000})
+    {
+        graph_model gm(1L, graph(n_flaws));
+        const auto prefix = "graph_model/" + std::to_string(n_flaws);
+
+        bench(prefix + "/apply", [&gm, n_flaws](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    json::json msg{{"type", "flaw_cost_changed"}, {"solver_id", 1L}, {"id", static_cast<long>(i % n_flaws)}, {"cost", static_cast<double>(i)}};
+                    auto s_msg = gm.apply(msg);
+                    do_not_optimize(s_msg);
+                } });
+        // a new version forces the snapshot to be serialized again..
+        bench(prefix + "/snapshot", [&gm](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    json::json msg{{"type", "flaw_state_changed"}, {"solver_id", 1L}, {"id", 0L}, {"state", i % 2 ? "active" : "forbidden"}};
+                    gm.apply(msg);
+                    auto snapshot = gm.snapshot();
+                    do_not_optimize(snapshot);
+                } });
+        // a fresh graph has no 256 versions to go back to (when the benchmark is run alone)..
+        for (long v = gm.get_version(); v < 256; ++v)
+        {
+            json::json msg{{"type", "flaw_cost_changed"}, {"solver_id", 1L}, {"id", 0L}, {"cost", static_cast<double>(v)}};
+            gm.apply(msg);
+        }
+        bench(prefix + "/deltas_256", [&gm](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto deltas = gm.deltas(gm.get_epoch(), gm.get_version() - 256);
+                    do_not_optimize(deltas);
+                } });
+    }
+}
+
+static void bench_sensor_series()
+{
+    const std::map<std::string, coco::parameter_type> parameters{{"temperature", coco::parameter_type::Float}, {"humidity", coco::parameter_type::Integer}, {"status", coco::parameter_type::Symbol}};
+
+    bench("sensor_series/push_back", [&parameters](std::size_t n)
+          {
+              sensor_series series(parameters, COCO_RECENT_VALUES);
+              for (std::size_t i = 0; i < n; ++i)
+              {
+                  json::json value{{"temperature", 20 + std::sin(i * 0.01)}, {"humidity", static_cast<long>(i % 100)}, {"status", "ok"}};
+                  series.push_back(static_cast<long>(i), value);
+              } });
+
+    sensor_series series(parameters);
+    const std::size_t n_values = 1000000;
+    for (std::size_t i = 0; i < n_values; ++i)
+    {
+        json::json value{{"temperature", 20 + std::sin(i * 0.01)}, {"humidity", static_cast<long>(i % 100)}, {"status", "ok"}};
+        series.push_back(static_cast<long>(i), value);
+    }
+    for (const long points : {100, 2000})
+        bench("sensor_series/downsample_1M_to_" + std::to_string(points), [&series, points](std::size_t n)
+              { for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto values = series.downsample(0, static_cast<long>(n_values), static_cast<long>(n_values) / points);
+                    do_not_optimize(values);
+                } });
+}
+
+static void bench_routing()
+{
+    router<int> r;
+    r.add(boost::beast::http::verb::post, "/login", 0);
+    r.add(boost::beast::http::verb::get, "/users", 1);
+    r.add(boost::beast::http::verb::put, "/user/:id", 2);
+    r.add(boost::beast::http::verb::get, "/sensor_types", 3);
+    r.add(boost::beast::http::verb::get, "/sensors", 4);
+    r.add(boost::beast::http::verb::get, "/sensor/:id", 5);
+    r.add(boost::beast::http::verb::post, "/sensors/values", 6);
+
+    const std::string_view target = "/sensor/64f0c0ffee0123456789abcd?from=1700000000000&to=1700003600000&points=2000";
+    bench("router/match_sensor_values", [&r, &target](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+            {
+                path_params params;
+                auto h = r.match(boost::beast::http::verb::get, path_of(target), params);
+                do_not_optimize(h);
+            } });
+    bench("router/query_params", [&target](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+            {
+                const query_params query(query_of(target));
+                auto to = query.get_number<long>("to");
+                auto points = query.get_number<long>("points");
+                do_not_optimize(to);
+                do_not_optimize(points);
+            } });
+}
+
+static void bench_queue()
+{
+    for (const std::size_t producers : {1, 4})
+        bench("mpsc_queue/" + std::to_string(producers) + "_producers", [producers](std::size_t n)
+              {
+                  mpsc_queue<std::size_t> q;
+                  std::vector<std::thread> threads;
+                  for (std::size_t p = 0; p < producers; ++p)
+                      threads.emplace_back([&q, n, producers]()
+                                           { for (std::size_t i = 0; i < n / producers; ++i)
+                                                 q.push(std::size_t(i)); });
+                  std::size_t popped = 0;
+                  while (popped < (n / producers) * producers)
+                      if (q.pop())
+                          ++popped;
+                  for (auto &t : threads)
+                      t.join(); });
+
+    histogram h;
+    bench("histogram/observe", [&h](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                h.observe(static_cast<std::uint64_t>(i & 0xFFFF)); });
+}
+
+/**
+ * @brief An in-memory stand-in for the MongoDB database: the base class keeps the users, the sensor types and the sensors in memory, and nothing is persisted.
+ */
+class memory_db final : public coco::coco_db
+{
+};
+
+/**
+ * @brief A GUI server, listening on the loopback interface and backed by the in-memory database, with an admin and the given number of sensors.
+ */
+class bench_server
+{
+public:
+    bench_server(const std::size_t n_sensors, const bool guests = false) : port(next_port++), gui(cc, "127.0.0.1", port)
+    {
+        gui.set_guest_logins(guests);
+        gui.set_high_water_mark(std::numeric_limits<std::size_t>::max()); // we measure the fan-out, not the slow consumer policy..
+        {
+            std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+            json::json data{{"type", "admin"}};
+            cc.create_user("admin@bench", "bench", "Bench", "Admin", {cc.get_database().get_root()}, data);
+            admin_token = cc.get_database().get_user("admin@bench", "bench")->get_id();
+            cc.create_sensor_type("bench_type", "A benchmark sensor type", {{"temperature", coco::parameter_type::Float}, {"status", coco::parameter_type::Symbol}});
+            std::string type_id;
+            for (const auto &st : cc.get_database().get_sensor_types())
+                if (st.get().get_name() == "bench_type")
+                    type_id = st.get().get_id();
+            for (std::size_t i = 0; i < n_sensors; ++i)
+                cc.create_sensor("bench_sensor_" + std::to_string(i), cc.get_database().get_sensor_type(type_id), coco::location_ptr());
+            for (const auto &sns : cc.get_database().get_sensors())
+                sensors.push_back(sns.get().get_id());
+        }
+        runner = std::thread([this]()
+                             { gui.network::server::start(); });
+
+        // we wait for the server to accept the connections..
+        net::io_context ioc;
+        for (int attempt = 0;; ++attempt)
+        {
+            beast::tcp_stream stream(ioc);
+            beast::error_code ec;
+            stream.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port), ec);
+            if (!ec)
+                break;
+            if (attempt == 500)
+                throw std::runtime_error("The benchmark server did not start");
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    ~bench_server()
+    {
+        gui.network::server::stop();
+        runner.join();
+    }
+
+    /**
+     * @brief Publishes a value of the i-th sensor through the core, as the middleware would.
+     */
+    void publish(const std::size_t i)
+    {
+        json::json value{{"temperature", static_cast<double>(i)}, {"status", "ok"}};
+        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        cc.publish_sensor_value(cc.get_database().get_sensor(sensors[i % sensors.size()]), value);
+    }
+
+    const unsigned short port;
+    memory_db db;
+    coco::coco_core cc{db};
+    coco_gui gui;
+    std::string admin_token;
+    std::vector<std::string> sensors;
+
+private:
+    std::thread runner;
+};
+
+/**
+ * @brief A keep-alive HTTP client of an in-process server.
+ */
+class http_client
+{
+public:
+    http_client(const unsigned short port) : stream(ioc) { stream.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port)); }
+
+    void request(const http::verb verb, const std::string &target, const std::string &token, const std::string &body = {})
+    {
+        http::request<http::string_body> req{verb, target, 11};
+        req.set(http::field::host, "127.0.0.1");
+        req.set("token", token);
+        req.keep_alive(true);
+        if (!body.empty())
+        {
+            req.set(http::field::content_type, "application/json");
+            req.body() = body;
+        }
+        req.prepare_payload();
+        http::write(stream, req);
+        http::response<http::string_body> res;
+        http::read(stream, buffer, res);
+        if (res.result_int() / 100 != 2)
+            throw std::runtime_error(std::string(http::to_string(verb)) + ' ' + target + " answered " + std::to_string(res.result_int()));
+    }
+
+private:
+    net::io_context ioc;
+    beast::tcp_stream stream;
+    beast::flat_buffer buffer;
+};
+
+/**
+ * @brief A WebSocket client of an in-process server which logs in, counts the sensor values it receives, and acknowledges the messages like the bundled client.
+ */
+class ws_client
+{
+public:
+    ws_client(const unsigned short port, const std::string &token, std::atomic<std::size_t> &values) : ws(ioc)
+    {
+        beast::get_lowest_layer(ws).connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+        ws.handshake("127.0.0.1", "/coco");
+        ws.write(net::buffer("{\"type\":\"login\",\"token\":\"" + token + "\"}"));
+        beast::flat_buffer buffer;
+        do // the session is synchronized once it receives the login answer..
+        {
+            buffer.consume(buffer.size());
+            ws.read(buffer);
+        } while (beast::buffers_to_string(buffer.data()).find("\"login\"") == std::string::npos);
+
+        reader = std::thread([this, token, &values]()
+                             {
+                                 beast::flat_buffer buffer;
+                                 beast::error_code ec;
+                                 for (std::size_t received = 1;; ++received)
+                                 {
+                                     ws.read(buffer, ec);
+                                     if (ec)
+                                         return;
+                                     if (std::string_view(static_cast<const char *>(buffer.data().data()), buffer.size()).find("\"new_sensor_value\"") != std::string_view::npos)
+                                         values++;
+                                     buffer.consume(buffer.size());
+                                     if (received % 32 == 0)
+                                         ws.write(net::buffer("{\"type\":\"ack\",\"token\":\"" + token + "\",\"received\":" + std::to_string(received) + "}"), ec);
+                                 } });
+    }
+    ~ws_client()
+    { // the reader is blocked on the socket, which we shut down to let it go..
+        beast::error_code ec;
+        beast::get_lowest_layer(ws).socket().shutdown(tcp::socket::shutdown_both, ec);
+        reader.join();
+    }
+
+private:
+    net::io_context ioc;
+    websocket::stream<beast::tcp_stream> ws;
+    std::thread reader;
+};
+
+static void bench_fanout()
+{
+    for (const std::size_t n_sessions : {1, 10, 100})
+    {
+        const auto name = "broadcast/" + std::to_string(n_sessions) + "_sessions";
+        if (!selected(name))
+            continue;
+
+        bench_server server(16, true);
+        std::atomic<std::size_t> values{0};
+        std::vector<std::unique_ptr<ws_client>> clients;
+        for (std::size_t i = 0; i < n_sessions; ++i)
+            clients.push_back(std::make_unique<ws_client>(server.port, "guest_" + std::to_string(i), values));
+
+        // each iteration is a sensor value published through the core and received by every session..
+        bench(name, [&server, &values, n_sessions](std::size_t n)
+              {
+                  const auto expected = values + n * n_sessions;
+                  for (std::size_t i = 0; i < n; ++i)
+                      server.publish(i);
+                  while (values < expected)
+                      std::this_thread::yield(); });
+    }
+}
+
+static void bench_rest()
+{
+    if (!selected("rest/"))
+        return;
+
+    bench_server server(1000);
+    http_client client(server.port);
+    const auto &token = server.admin_token;
+    const auto &sensor = server.sensors.front();
+
+    bench("rest/get_users", [&client, &token](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                client.request(http::verb::get, "/users", token); });
+    bench("rest/get_sensor_types", [&client, &token](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                client.request(http::verb::get, "/sensor_types", token); });
+    bench("rest/get_sensors_1000", [&client, &token](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                client.request(http::verb::get, "/sensors", token); });
+    bench("rest/post_sensor_value", [&client, &token, &sensor](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                client.request(http::verb::post, "/sensor/" + sensor, token, "{\"temperature\":" + std::to_string(i) + ",\"status\":\"ok\"}"); });
+    bench("rest/get_sensor_values", [&client, &token, &sensor](std::size_t n)
+          { for (std::size_t i = 0; i < n; ++i)
+                client.request(http::verb::get, "/sensor/" + sensor + "?limit=100", token); });
+}
+
+static void bench_login()
+{
+    for (const std::size_t n_sensors : {100, 1000, 10000})
+    {
+        const auto name = "login_snapshot/" + std::to_string(n_sensors) + "_sensors";
+        if (!selected(name))
+            continue;
+
+        bench_server server(n_sensors);
+        // each iteration is an admin connecting, logging in and receiving the whole snapshot, which the users list closes..
+        bench(name, [&server](std::size_t n)
+              {
+                  net::io_context ioc;
+                  for (std::size_t i = 0; i < n; ++i)
+                  {
+                      websocket::stream<beast::tcp_stream> ws(ioc);
+                      beast::get_lowest_layer(ws).connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), server.port));
+                      ws.handshake("127.0.0.1", "/coco");
+                      ws.write(net::buffer("{\"type\":\"login\",\"token\":\"" + server.admin_token + "\"}"));
+                      beast::flat_buffer buffer;
+                      do
+                      {
+                          buffer.consume(buffer.size());
+                          ws.read(buffer);
+                      } while (beast::buffers_to_string(buffer.data()).find("\"type\":\"users\"") == std::string::npos);
+                      ws.close(websocket::close_code::normal);
+                  } }, std::chrono::milliseconds(2000));
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    for (int i = 1; i < argc - 1; i++)
+        if (std::string(argv[i]) == "-filter")
+            filter = argv[++i];
+
+    bench_messages();
+    bench_graph_model();
+    bench_sensor_series();
+    bench_routing();
+    bench_queue();
+    bench_fanout();
+    bench_rest();
+    bench_login();
+
+    return 0;
+}
@@ -1,38 +1,284 @@
 #include "coco_gui.h"
 #include "coco_db.h"
 #include "coco_executor.h"
+#include "json_writer.h"
+#include "msgpack.h"
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
 #include <iomanip>
+#include <sstream>
 
 namespace coco::coco_gui
 {
-    coco_gui::coco_gui(coco::coco_core &cc, const std::string &coco_host, const unsigned short coco_port) : network::server(coco_host, coco_port), coco::coco_listener(cc)
+    static std::string topic(const std::string &kind, const json::json &id) { return kind + ':' + id.to_string(); }
+    static std::string solver_topic(const coco_executor &exec) { return topic("solver", get_id(exec.get_executor().get_solver())); }
+
+    /**
+     * @brief Whether the `If-None-Match` header of the request lists the given entity tag (or is `*`), the weak tags matching their strong counterpart.
+     */
+    static bool not_modified(const network::request &req, const std::string &etag)
+    {
+        if (!req.count(boost::beast::http::field::if_none_match))
+            return false;
+        const auto inm = req[boost::beast::http::field::if_none_match];
+        const std::string_view tags(inm.data(), inm.size());
+        for (std::size_t pos = 0; pos < tags.size();)
+        {
+            auto end = tags.find(',', pos);
+            if (end == std::string_view::npos)
+                end = tags.size();
+            auto tag = tags.substr(pos, end - pos);
+            while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t'))
+                tag.remove_prefix(1);
+            while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t'))
+                tag.remove_suffix(1);
+            if (tag.substr(0, 2) == "W/")
+                tag.remove_prefix(2);
+            if (tag == "*" || tag == etag)
+                return true;
+            pos = end + 1;
+        }
+        return false;
+    }
+
+    /**
+     * @brief The quality value given by the `Accept-Encoding` header of the request to the given content coding (or to `*`, if the coding is not listed), 0 meaning that the coding is not acceptable.
+     */
+    static double accepted_encoding(const network::request &req, const std::string_view &coding)
+    {
+        if (!req.count(boost::beast::http::field::accept_encoding))
+            return 0;
+        const auto trim = [](std::string_view v)
+        {
+            while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+                v.remove_prefix(1);
+            while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+                v.remove_suffix(1);
+            return v;
+        };
+        const auto iequals = [](const std::string_view &a, const std::string_view &b)
+        { return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                                                     { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); }); };
+
+        const auto ae = req[boost::beast::http::field::accept_encoding];
+        const std::string_view codings(ae.data(), ae.size());
+        std::optional<double> q_coding, q_any;
+        for (std::size_t pos = 0; pos < codings.size();)
+        {
+            auto end = codings.find(',', pos);
+            if (end == std::string_view::npos)
+                end = codings.size();
+            auto item = codings.substr(pos, end - pos);
+            const auto name = trim(item.substr(0, item.find(';')));
+            double q = 1;
+            for (auto semi = item.find(';'); semi != std::string_view::npos;)
+            { // the parameters of the coding, of which only the quality value matters..
+                const auto next = item.find(';', semi + 1);
+                const auto param = trim(item.substr(semi + 1, next == std::string_view::npos ? std::string_view::npos : next - semi - 1));
+                if (param.size() > 2 && iequals(param.substr(0, 2), "q="))
+                    q = std::strtod(std::string(param.substr(2)).c_str(), nullptr); // a malformed value makes the coding unacceptable..
+                semi = next;
+            }
+            if (iequals(name, coding))
+                q_coding = q;
+            else if (name == "*")
+                q_any = q;
+            pos = end + 1;
+        }
+        return q_coding ? *q_coding : q_any.value_or(0);
+    }
+
+    coco_gui::coco_gui(coco::coco_core &cc, const std::string &coco_host, const unsigned short coco_port, const std::size_t concurrency) : network::server(coco_host, coco_port, std::max<std::size_t>(concurrency, 1)), coco::coco_listener(cc), sessions(std::make_shared<const session_registry>()), subscriptions(std::make_shared<const subscription_index>())
     {
         LOG_DEBUG("Creating coco_gui..");
-        add_file_route("^/$", "client/dist/index.html");
-        add_file_route("^/favicon.ico$", "client/dist");
-        add_file_route("^/assets/.*$", "client/dist");
-
-        add_route(boost::beast::http::verb::post, "^/login$", std::bind(&coco_gui::login, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::get, "^/users$", std::bind(&coco_gui::get_users, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::post, "^/user$", std::bind(&coco_gui::create_user, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::put, "^/user/.*$", std::bind(&coco_gui::update_user, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::delete_, "^/user/.*$", std::bind(&coco_gui::delete_user, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::get, "^/sensor_types$", std::bind(&coco_gui::get_sensor_types, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::post, "^/sensor_type$", std::bind(&coco_gui::create_sensor_type, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::get, "^/sensors$", std::bind(&coco_gui::get_sensors, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::post, "^/sensor$", std::bind(&coco_gui::create_sensor, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::get, "^/sensor/.*$", std::bind(&coco_gui::get_sensor_values, this, std::placeholders::_1, std::placeholders::_2));
-        add_route(boost::beast::http::verb::post, "^/sensor/.*$", std::bind(&coco_gui::publish_sensor_value, this, std::placeholders::_1, std::placeholders::_2));
+        if (!assets.size())
+            LOG_WARN("No client found in client/dist..");
+        add_route(boost::beast::http::verb::get, "^/(favicon\\.ico|assets/.*)?$", std::bind(&coco_gui::serve_asset, this, std::placeholders::_1, std::placeholders::_2));
+
+        add_api_route(boost::beast::http::verb::post, "/login", [this](network::request &req, network::response &res, const path_params &)
+                      { login(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/principal", [this](network::request &req, network::response &res, const path_params &)
+                      { get_principal(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/users", [this](network::request &req, network::response &res, const path_params &)
+                      { get_users(req, res); });
+        add_api_route(boost::beast::http::verb::post, "/user", [this](network::request &req, network::response &res, const path_params &)
+                      { create_user(req, res); });
+        add_api_route(boost::beast::http::verb::put, "/user/:id", [this](network::request &req, network::response &res, const path_params &params)
+                      { update_user(req, res, std::string(params[0])); });
+        add_api_route(boost::beast::http::verb::delete_, "/user/:id", [this](network::request &req, network::response &res, const path_params &params)
+                      { delete_user(req, res, std::string(params[0])); });
+        add_api_route(boost::beast::http::verb::get, "/sensor_types", [this](network::request &req, network::response &res, const path_params &)
+                      { get_sensor_types(req, res); });
+        add_api_route(boost::beast::http::verb::post, "/sensor_type", [this](network::request &req, network::response &res, const path_params &)
+                      { create_sensor_type(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/sensors", [this](network::request &req, network::response &res, const path_params &)
+                      { get_sensors(req, res); });
+        add_api_route(boost::beast::http::verb::post, "/sensor", [this](network::request &req, network::response &res, const path_params &)
+                      { create_sensor(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/sensor/:id", [this](network::request &req, network::response &res, const path_params &params)
+                      { get_sensor_values(req, res, std::string(params[0])); });
+        add_api_route(boost::beast::http::verb::post, "/sensor/:id", [this](network::request &req, network::response &res, const path_params &params)
+                      { publish_sensor_value(req, res, std::string(params[0])); });
+        add_api_route(boost::beast::http::verb::post, "/sensors/values", [this](network::request &req, network::response &res, const path_params &)
+                      { publish_sensor_values(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/sessions", [this](network::request &req, network::response &res, const path_params &)
+                      { get_sessions(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/metrics", [this](network::request &req, network::response &res, const path_params &)
+                      { get_metrics(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/ready", [this](network::request &req, network::response &res, const path_params &)
+                      { get_ready(req, res); });
+        add_api_route(boost::beast::http::verb::get, "/lock_profile", [this](network::request &req, network::response &res, const path_params &)
+                      { get_lock_profile(req, res); });
+        add_api_route(boost::beast::http::verb::put, "/lock_profile", [this](network::request &req, network::response &res, const path_params &)
+                      { update_lock_profile(req, res); });
+
+        // the server matches a single, prefix-only, expression per verb, the routes being resolved by the route table..
+        for (auto verb : {boost::beast::http::verb::get, boost::beast::http::verb::post, boost::beast::http::verb::put, boost::beast::http::verb::delete_, boost::beast::http::verb::options})
+            add_route(verb, "^/(login|principal|users?|sensor_types?|sensors?|sessions|metrics|lock_profile|ready)([/?].*)?$", std::bind(&coco_gui::dispatch, this, std::placeholders::_1, std::placeholders::_2));
 
         add_ws_route("/coco")
             .on_open(std::bind(&coco_gui::on_ws_open, this, std::placeholders::_1))
             .on_message(std::bind(&coco_gui::on_ws_message, this, std::placeholders::_1, std::placeholders::_2))
             .on_error(std::bind(&coco_gui::on_ws_error, this, std::placeholders::_1, std::placeholders::_2));
+
+        fanout_thread = std::thread(&coco_gui::fanout, this);
+        writer_thread = std::thread(&coco_gui::write_values, this);
+    }
+    coco_gui::~coco_gui()
+    {
+        { // the queued sensor values are written before leaving..
+            std::lock_guard<std::mutex> _(values_mtx);
+            writing = false;
+            values_cv.notify_one();
+        }
+        writer_thread.join();
+        running = false;
+        {
+            std::lock_guard<std::mutex> _(wake_mtx);
+            wake_cv.notify_one();
+        }
+        fanout_thread.join();
+        lock_profiler::stop();
+    }
+
+    void coco_gui::dispatch(network::request &req, network::response &res)
+    {
+        const std::string_view target(req.target().data(), req.target().size());
+        const auto path = path_of(target);
+        responded();
+        if (req.count(boost::beast::http::field::origin))
+        { // the relays redirect their clients here, from another origin (the token being a header, the requests carry no credentials)..
+            res.set(boost::beast::http::field::access_control_allow_origin, "*");
+            if (req.method() == boost::beast::http::verb::options)
+            { // the preflight of the redirected requests..
+                res.result(boost::beast::http::status::no_content);
+                res.set(boost::beast::http::field::access_control_allow_methods, "GET, POST, PUT, DELETE");
+                res.set(boost::beast::http::field::access_control_allow_headers, "token, content-type, if-none-match");
+                res.set(boost::beast::http::field::access_control_max_age, "600");
+                return;
+            }
+        }
+        if (!ready && path != "/ready")
+        {
+            res.result(boost::beast::http::status::service_unavailable);
+            res.set(boost::beast::http::field::retry_after, "1");
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "The server is starting"}}.to_string();
+            return;
+        }
+        if (upstream && !relayed_route(req.method(), path))
+        { // the relay serves the lists only, the rest of the API being served by the primary..
+            res.result(boost::beast::http::status::temporary_redirect);
+            res.set(boost::beast::http::field::location, "http://" + upstream->host + ':' + upstream->port + std::string(target));
+            return;
+        }
+
+        path_params params;
+        if (auto route = api.match(req.method(), path, params))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                route->handle(req, res, params);
+            }
+            catch (const upstream_error &e)
+            { // a relay which lost its primary..
+                res.result(boost::beast::http::status::bad_gateway);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", e.what()}}.to_string();
+            }
+            route->metrics.latency.observe(std::chrono::steady_clock::now() - start);
+            route->metrics.request_size.observe(req.body().size());
+            route->metrics.response_size.observe(res.body().size());
+        }
+        else
+        {
+            res.result(boost::beast::http::status::not_found);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "Not found"}}.to_string();
+        }
+    }
+
+    bool coco_gui::relayed_route(const boost::beast::http::verb verb, const std::string_view &path)
+    {
+        if (path == "/lock_profile")
+            return true; // the profile is that of the relay..
+        return verb == boost::beast::http::verb::get && (path == "/principal" || path == "/users" || path == "/sensor_types" || path == "/sensors" || path == "/sessions" || path == "/metrics" || path == "/ready");
+    }
+
+    void coco_gui::add_api_route(const boost::beast::http::verb verb, const std::string_view &pattern, std::function<void(network::request &, network::response &, const path_params &)> &&handle)
+    {
+        const auto v = boost::beast::http::to_string(verb);
+        api.add(verb, pattern, {std::move(handle), metrics.routes.get(std::string(v.data(), v.size()) + ' ' + std::string(pattern))});
+    }
+
+    void coco_gui::serve_asset(network::request &req, network::response &res)
+    {
+        responded();
+        const std::string_view target(req.target().data(), req.target().size());
+        const auto path = path_of(target);
+        const auto a = assets.find(path == "/" ? "/index.html" : path);
+        if (!a)
+        {
+            res.result(boost::beast::http::status::not_found);
+            return;
+        }
+
+        // the preferred encoding among the acceptable ones, brotli winning the ties..
+        const double q_br = a->brotli.empty() ? 0 : accepted_encoding(req, "br"), q_gzip = a->gzip.empty() ? 0 : accepted_encoding(req, "gzip");
+        const std::string *body = &a->body;
+        std::string etag = a->etag;
+        if (q_br > 0 && q_br >= q_gzip)
+        {
+            body = &a->brotli;
+            etag.insert(etag.size() - 1, "-br"); // each encoding is a different representation, with its own validator..
+            res.set(boost::beast::http::field::content_encoding, "br");
+        }
+        else if (q_gzip > 0)
+        {
+            body = &a->gzip;
+            etag.insert(etag.size() - 1, "-gz");
+            res.set(boost::beast::http::field::content_encoding, "gzip");
+        }
+
+        res.set(boost::beast::http::field::etag, etag);
+        res.set(boost::beast::http::field::vary, "Accept-Encoding");
+        res.set(boost::beast::http::field::cache_control, a->immutable ? "public, max-age=31536000, immutable" : "no-cache");
+        if (not_modified(req, etag))
+        {
+            res.erase(boost::beast::http::field::content_encoding);
+            res.result(boost::beast::http::status::not_modified);
+            return;
+        }
+        res.set(boost::beast::http::field::content_type, a->content_type);
+        res.body() = *body;
     }
 
     void coco_gui::login(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("login"));
         auto x = json::load(boost::beast::buffers_to_string(req.body().data()));
         if (!x.has("email") || !x.has("password"))
         {
@@ -66,14 +312,15 @@ namespace coco::coco_gui
             res.body() = json::json{{"success", false}, {"message", "Token must be provided"}}.to_string();
             return false;
         }
-        else if (!cc.get_database().has_user(req["token"].to_string()))
+        auto p = get_principal(req["token"].to_string());
+        if (!p)
         {
             res.result(boost::beast::http::status::unauthorized);
             res.set(boost::beast::http::field::content_type, "application/json");
             res.body() = json::json{{"success", false}, {"message", "Invalid token"}}.to_string();
             return false;
         }
-        else if (admin && cc.get_database().get_user(req["token"].to_string()).get_data()["type"] != "admin")
+        else if (admin && !p->admin)
         {
             res.result(boost::beast::http::status::forbidden);
             res.set(boost::beast::http::field::content_type, "application/json");
@@ -84,29 +331,84 @@ namespace coco::coco_gui
             return true;
     }
 
+    std::shared_ptr<const coco_gui::principal> coco_gui::get_principal(const std::string &token)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::uint64_t generation;
+        {
+            std::lock_guard<std::mutex> _(principals_mtx);
+            if (auto it = principals.find(token); it != principals.end())
+            {
+                if (it->second->expires > now)
+                    return it->second;
+                principals.erase(it);
+            }
+            generation = principals_generation;
+        }
+
+        // we resolve the token through the database, and remember the result..
+        std::shared_ptr<const principal> p;
+        if (upstream)
+        { // a relay asks the primary, without holding the core mutex..
+            const auto r = upstream_get(upstream->host, upstream->port, "/principal", token);
+            if (r.status == static_cast<unsigned>(boost::beast::http::status::unauthorized))
+                return nullptr;
+            if (r.status != static_cast<unsigned>(boost::beast::http::status::ok))
+                throw upstream_error("The primary server answered /principal with " + std::to_string(r.status));
+            auto j_p = json::load(r.body);
+            std::string id = j_p["user"]["id"];
+            p = std::make_shared<const principal>(principal{std::move(id), static_cast<bool>(j_p["admin"]), static_cast<bool>(j_p["member"]), std::move(j_p["user"]), now + std::chrono::seconds(COCO_TOKEN_TTL)});
+        }
+        else
+        {
+            const core_lock _(cc.get_mutex(), metrics.lock_sites.get("get_principal"));
+            if (!cc.get_database().has_user(token))
+                return nullptr;
+            auto &usr = cc.get_database().get_user(token);
+            const bool member = std::find(usr.get_roots().begin(), usr.get_roots().end(), cc.get_database().get_root()) != usr.get_roots().end();
+            p = std::make_shared<const principal>(principal{usr.get_id(), usr.get_data()["type"] == "admin", member, to_json(usr), now + std::chrono::seconds(COCO_TOKEN_TTL)});
+        }
+        std::lock_guard<std::mutex> _(principals_mtx);
+        if (generation == principals_generation) // a user changed while we were resolving the token, which might have been resolved before the change..
+            principals[token] = p;
+        return p;
+    }
+
+    void coco_gui::forget_principal(const std::string &token)
+    {
+        std::lock_guard<std::mutex> _(principals_mtx);
+        principals.erase(token);
+        principals_generation++;
+    }
+
+    void coco_gui::get_principal(network::request &req, network::response &res)
+    {
+        if (!authorize(req, res))
+            return;
+        auto p = get_principal(req["token"].to_string());
+        if (!p)
+        { // the user was removed meanwhile..
+            res.result(boost::beast::http::status::unauthorized);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "Invalid token"}}.to_string();
+            return;
+        }
+
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = json::json{{"user", p->user}, {"admin", p->admin}, {"member", p->member}}.to_string();
+    }
+
     void coco_gui::get_users(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
         if (!authorize(req, res, true))
             return;
 
-        res.set(boost::beast::http::field::content_type, "application/json");
-        json::json j_users;
-        j_users["type"] = "users";
-        json::json c_users(json::json_type::array);
-        for (const auto &user : cc.get_database().get_users())
-        {
-            json::json j_u = to_json(user.get());
-            if (user_to_ws.count(user.get().get_id()))
-                j_u["connected"] = true;
-            c_users.push_back(std::move(j_u));
-        }
-        j_users["users"] = std::move(c_users);
-        res.body() = j_users.to_string();
+        respond(req, res, *get_cached(users_cache, [this]()
+                                      { return users_message(); }));
     }
     void coco_gui::create_user(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("create_user"));
         if (!authorize(req, res, true))
             return;
 
@@ -136,13 +438,12 @@ namespace coco::coco_gui
 
         cc.create_user(email, password, first_name, last_name, roots, x["data"]);
     }
-    void coco_gui::update_user(network::request &req, network::response &res)
+    void coco_gui::update_user(network::request &req, network::response &res, const std::string &user_id)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("update_user"));
         if (!authorize(req, res, true))
             return;
 
-        std::string user_id = req.target().to_string().substr(6);
         if (!cc.get_database().has_user(user_id))
         {
             res.result(boost::beast::http::status::not_found);
@@ -169,14 +470,15 @@ namespace coco::coco_gui
         }
         if (x.has("data"))
             cc.get_database().set_user_data(user_id, x["data"]);
+        invalidate(users_cache);
+        forget_principal(user_id);
     }
-    void coco_gui::delete_user(network::request &req, network::response &res)
+    void coco_gui::delete_user(network::request &req, network::response &res, const std::string &user_id)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("delete_user"));
         if (!authorize(req, res, true))
             return;
 
-        std::string user_id = req.target().to_string().substr(6);
         if (!cc.get_database().has_user(user_id))
         {
             res.result(boost::beast::http::status::not_found);
@@ -186,26 +488,21 @@ namespace coco::coco_gui
         }
 
         cc.get_database().delete_user(user_id);
+        invalidate(users_cache);
+        forget_principal(user_id);
     }
 
     void coco_gui::get_sensor_types(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
         if (!authorize(req, res))
             return;
 
-        res.set(boost::beast::http::field::content_type, "application/json");
-        json::json j_sensor_types;
-        j_sensor_types["type"] = "sensor_types";
-        json::json c_sensor_types(json::json_type::array);
-        for (const auto &sensor_type : cc.get_database().get_sensor_types())
-            c_sensor_types.push_back(to_json(sensor_type.get()));
-        j_sensor_types["sensor_types"] = std::move(c_sensor_types);
-        res.body() = j_sensor_types.to_string();
+        respond(req, res, *get_cached(sensor_types_cache, [this]()
+                                      { return sensor_types_message(); }));
     }
     void coco_gui::create_sensor_type(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("create_sensor_type"));
         if (!authorize(req, res, true))
             return;
 
@@ -260,22 +557,14 @@ namespace coco::coco_gui
 
     void coco_gui::get_sensors(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
         if (!authorize(req, res))
             return;
 
-        res.set(boost::beast::http::field::content_type, "application/json");
-        json::json j_sensors;
-        j_sensors["type"] = "sensors";
-        json::json c_sensors(json::json_type::array);
-        for (const auto &sensor : cc.get_database().get_sensors())
-            c_sensors.push_back(to_json(sensor.get()));
-        j_sensors["sensors"] = std::move(c_sensors);
-        res.body() = j_sensors.to_string();
+        respond(req, res, *sensors_response());
     }
     void coco_gui::create_sensor(network::request &req, network::response &res)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
+        const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("create_sensor"));
         if (!authorize(req, res, true))
             return;
 
@@ -313,46 +602,59 @@ namespace coco::coco_gui
         cc.create_sensor(name, cc.get_database().get_sensor_type(type), std::move(l));
     }
 
-    void coco_gui::get_sensor_values(network::request &req, network::response &res)
+    void coco_gui::get_sensor_values(network::request &req, network::response &res, const std::string &sensor_id)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
         if (!authorize(req, res))
             return;
-
-        std::size_t query_start = req.target().find('?', 8);
-        std::string sensor_id = query_start == std::string::npos ? req.target().substr(8).to_string() : req.target().substr(8, query_start - 8).to_string();
-        if (!cc.get_database().has_sensor(sensor_id))
+        const auto c_catalog = get_catalog();
+        const auto sns = c_catalog->find(sensor_id);
+        if (sns == c_catalog->end())
         {
             res.result(boost::beast::http::status::not_found);
             res.set(boost::beast::http::field::content_type, "application/json");
             res.body() = json::json{{"success", false}, {"message", "Sensor not found"}}.to_string();
             return;
         }
-        std::map<std::string, std::string> fields;
-        if (query_start != std::string::npos)
-        {
-            std::string query = req.target().substr(query_start + 1).to_string();
-            std::regex r("([^=&?]+)=([^=&?]+)");
-            std::smatch m;
-            while (std::regex_search(query, m, r))
-            {
-                fields[m[1].str()] = m[2].str();
-                query = m.suffix().str();
-            }
-        }
+        const query_params query(query_of(std::string_view(req.target().data(), req.target().size())));
 
         std::chrono::system_clock::time_point to;
-        if (fields.count("to"))
-            to = std::chrono::system_clock::time_point{std::chrono::milliseconds{std::stoll(fields["to"])}};
+        if (auto q_to = query.get_number<long>("to"))
+            to = std::chrono::system_clock::time_point{std::chrono::milliseconds{*q_to}};
         else
             to = std::chrono::system_clock::now();
 
         std::chrono::system_clock::time_point from;
-        if (fields.count("from"))
-            from = std::chrono::system_clock::time_point{std::chrono::milliseconds{std::stoll(fields["from"])}};
+        std::size_t skip = 0; // the number of values, at the `from` timestamp, already sent with the previous pages..
+        if (auto q_cursor = query.get("cursor"))
+        { // we resume from where the previous page stopped, the cursor being made of a timestamp and of an offset among the values sharing it..
+            long c_ts;
+            const auto sep = q_cursor->find('_');
+            const auto c_end = q_cursor->data() + q_cursor->size();
+            if (auto [ptr, ec] = std::from_chars(q_cursor->data(), c_end, c_ts); ec != std::errc() || sep == std::string_view::npos || ptr != q_cursor->data() + sep || std::from_chars(ptr + 1, c_end, skip).ptr != c_end)
+            {
+                res.result(boost::beast::http::status::bad_request);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", "Invalid cursor"}}.to_string();
+                return;
+            }
+            from = std::chrono::system_clock::time_point{std::chrono::milliseconds{c_ts}};
+        }
+        else if (auto q_from = query.get_number<long>("from"))
+            from = std::chrono::system_clock::time_point{std::chrono::milliseconds{*q_from}};
         else
             from = to - std::chrono::hours{24 * 30};
 
+        const auto q_limit = query.get_number<long>("limit");
+        if (query.has("limit") && (!q_limit || *q_limit < 1))
+        {
+            res.result(boost::beast::http::status::bad_request);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "The limit must be positive"}}.to_string();
+            return;
+        }
+        const std::size_t limit = q_limit ? static_cast<std::size_t>(*q_limit) : COCO_SENSOR_VALUES_LIMIT;
+        const bool ndjson = query.get("format") == "ndjson" || (req.count(boost::beast::http::field::accept) && req[boost::beast::http::field::accept].find("application/x-ndjson") != boost::beast::string_view::npos);
+
 #ifdef VERBOSE_LOG
         auto from_t = std::chrono::system_clock::to_time_t(from);
         auto to_t = std::chrono::system_clock::to_time_t(to);
@@ -361,18 +663,145 @@ namespace coco::coco_gui
         LOG_DEBUG("To: " << std::put_time(std::localtime(&to_t), "%c %Z"));
 #endif
 
-        res.set(boost::beast::http::field::content_type, "application/json");
-        res.body() = cc.get_database().get_sensor_values(cc.get_database().get_sensor(sensor_id), from, to).to_string();
+        if (query.has("points") || query.has("bucket"))
+        { // we reduce the values, server side, into buckets..
+            const auto q_points = query.get_number<long>("points");
+            const auto q_bucket = query.get_number<long>("bucket");
+            if ((query.has("points") && (!q_points || *q_points < 1)) || (query.has("bucket") && (!q_bucket || *q_bucket < 1)))
+            {
+                res.result(boost::beast::http::status::bad_request);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", "The points and the bucket must be positive"}}.to_string();
+                return;
+            }
+            const long l_from = std::chrono::duration_cast<std::chrono::milliseconds>(from.time_since_epoch()).count();
+            const long l_end = std::chrono::duration_cast<std::chrono::milliseconds>(to.time_since_epoch()).count() + 1; // the buckets cover [from, to], as the raw values do..
+            const long span = std::max(0L, l_end - l_from);
+            const long bucket = q_bucket ? *q_bucket : std::max(1L, span / *q_points + (span % *q_points != 0));
+            if (span / bucket + (span % bucket != 0) > COCO_SENSOR_VALUES_LIMIT)
+            { // as the pages of raw values, the reduced values are bounded..
+                res.result(boost::beast::http::status::bad_request);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", "Too many buckets, at most " + std::to_string(COCO_SENSOR_VALUES_LIMIT) + " are allowed"}}.to_string();
+                return;
+            }
+
+            res.set(boost::beast::http::field::content_type, "application/json");
+            std::optional<json::json> values;
+            {
+                std::lock_guard<std::mutex> _(recent_values_mtx);
+                if (auto it = recent_values.find(sensor_id); it != recent_values.end() && !it->second->empty() && it->second->front_timestamp() <= l_from)
+                    values = it->second->downsample(l_from, l_end, bucket); // the requested values are all in memory..
+            }
+            if (values)
+            { // the values are serialized without holding the lock, which the new values wait for..
+                res.body() = values->to_string();
+                return;
+            }
+
+            // the values are reduced as the slices are read, rather than being collected first..
+            sensor_downsampler reducer(sns->second, l_from, l_end, bucket);
+            for_each_sensor_value(sensor_id, from, to, COCO_SENSOR_VALUES_LIMIT, [&reducer](json::json &value)
+                                  { reducer.push_back(value);
+                                    return true; });
+            res.body() = reducer.finish().to_string();
+            return;
+        }
+
+        // we append the values to the body until the page is full..
+        std::string body = ndjson ? "" : "[";
+        std::size_t count = 0;
+        long last = 0;            // the timestamp of the last value of the page..
+        std::size_t same = 0;     // the number of values, sent with this page or the previous ones, at that timestamp..
+        std::optional<long> next; // the timestamp of the first value which did not fit into the page..
+        const long l_from = std::chrono::duration_cast<std::chrono::milliseconds>(from.time_since_epoch()).count();
+        for_each_sensor_value(sensor_id, from, to, skip + limit + 1, [&](json::json &value)
+                              {
+                                  const auto timestamp = static_cast<long>(value["timestamp"]);
+                                  if (skip && timestamp == l_from)
+                                  { // the value has been sent with a previous page..
+                                      skip--;
+                                      same++;
+                                      last = timestamp;
+                                      return true;
+                                  }
+                                  if (count == limit)
+                                  {
+                                      next = timestamp;
+                                      return false;
+                                  }
+                                  same = timestamp == last ? same + 1 : 1;
+                                  last = timestamp;
+                                  if (ndjson)
+                                      body += value.to_string() + '\n';
+                                  else
+                                  {
+                                      if (count)
+                                          body += ',';
+                                      body += value.to_string();
+                                  }
+                                  ++count;
+                                  return true; });
+        if (!ndjson)
+            body += ']';
+
+        if (next)
+        { // there are more values, to be requested starting from the cursor..
+            res.set("Next-Cursor", std::to_string(*next) + '_' + std::to_string(*next == last ? same : 0));
+            res.set(boost::beast::http::field::access_control_expose_headers, "Next-Cursor");
+        }
+        res.set(boost::beast::http::field::content_type, ndjson ? "application/x-ndjson" : "application/json");
+        res.body() = std::move(body);
     }
 
-    void coco_gui::publish_sensor_value(network::request &req, network::response &res)
+    void coco_gui::for_each_sensor_value(const std::string &sensor_id, const std::chrono::system_clock::time_point &from, const std::chrono::system_clock::time_point &to, const std::size_t batch, const std::function<bool(json::json &)> &f)
+    {
+        const long l_from = std::chrono::duration_cast<std::chrono::milliseconds>(from.time_since_epoch()).count(), l_to = std::chrono::duration_cast<std::chrono::milliseconds>(to.time_since_epoch()).count();
+        std::optional<sensor_series> values;
+        {
+            std::lock_guard<std::mutex> _(recent_values_mtx);
+            if (auto it = recent_values.find(sensor_id); it != recent_values.end() && !it->second->empty() && it->second->front_timestamp() <= l_from)
+                values.emplace(it->second->range(l_from, l_to)); // the requested values are all in memory, we copy them out of the lock, which the new values wait for..
+        }
+        if (values)
+        {
+            values->for_each(l_from, l_to, f);
+            return;
+        }
+
+        // we read the values a time slice at a time, taking the core mutex only for reading each slice, the slices being sized to hold about a batch of values..
+        std::chrono::milliseconds slice = sensor_values_slice;
+        for (auto slice_from = from; slice_from < to;)
+        {
+            const auto slice_to = to - slice_from > slice ? slice_from + slice : to;
+            const long l_slice_to = std::chrono::duration_cast<std::chrono::milliseconds>(slice_to.time_since_epoch()).count();
+            json::json values;
+            {
+                const core_lock lock(cc.get_mutex(), metrics.lock_sites.get("for_each_sensor_value"));
+                if (!cc.get_database().has_sensor(sensor_id))
+                    return;
+                values = cc.get_database().get_sensor_values(cc.get_database().get_sensor(sensor_id), slice_from, slice_to);
+            }
+            std::size_t n = 0;
+            for (size_t i = 0; i < values.size(); ++i)
+                if (slice_to < to && static_cast<long>(values[i]["timestamp"]) >= l_slice_to)
+                    continue; // the value belongs to the next slice..
+                else if (!f(values[i]))
+                    return;
+                else
+                    n++;
+            slice_from = slice_to;
+            // the next slice is sized, from the density of this one, to hold about a batch of values (a sparse history being read in a few large slices)..
+            slice = std::min(n ? std::clamp(std::chrono::milliseconds{slice.count() * static_cast<long>(batch) / static_cast<long>(n)}, std::chrono::milliseconds{1}, 8 * slice) : 8 * slice, std::chrono::milliseconds{std::chrono::hours{24 * 365}});
+        }
+    }
+
+    void coco_gui::publish_sensor_value(network::request &req, network::response &res, const std::string &sensor_id)
     {
-        const std::lock_guard<std::recursive_mutex> lock(cc.get_mutex());
         if (!authorize(req, res, true))
             return;
 
-        std::string sensor_id = req.target().to_string().substr(8);
-        if (!cc.get_database().has_sensor(sensor_id))
+        if (!get_catalog()->count(sensor_id))
         {
             res.result(boost::beast::http::status::not_found);
             res.set(boost::beast::http::field::content_type, "application/json");
@@ -380,282 +809,1996 @@ namespace coco::coco_gui
             return;
         }
 
-        cc.publish_sensor_value(cc.get_database().get_sensor(sensor_id), json::load(boost::beast::buffers_to_string(req.body().data())));
+        std::vector<std::pair<std::string, json::json>> values;
+        values.emplace_back(sensor_id, json::load(boost::beast::buffers_to_string(req.body().data())));
+        write_behind(res, std::move(values));
     }
 
-    void coco_gui::on_ws_open(network::websocket_session &ws)
+    void coco_gui::publish_sensor_values(network::request &req, network::response &res)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        ws_to_user[&ws] = "";
-    }
+        if (!authorize(req, res, true))
+            return;
 
-    void coco_gui::on_ws_message(network::websocket_session &ws, const std::string &msg)
-    {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        auto x = json::load(msg);
-        if (x.get_type() != json::json_type::object || !x.get_object().count("type") || !x.get_object().count("token"))
+        // we parse the records, either a JSON array or newline-delimited JSON, without holding the core mutex..
+        std::vector<json::json> records;
+        const auto body = boost::beast::buffers_to_string(req.body().data());
+        if (req.count(boost::beast::http::field::content_type) && req[boost::beast::http::field::content_type].find("application/x-ndjson") != boost::beast::string_view::npos)
         {
-            ws.close(boost::beast::websocket::close_code::bad_payload);
-            return;
+            std::istringstream ss(body);
+            std::string line;
+            while (std::getline(ss, line))
+                if (line.find_first_not_of(" \t\r") != std::string::npos)
+                    try
+                    {
+                        records.push_back(json::load(line));
+                    }
+                    catch (const std::exception &)
+                    { // a malformed line fails its own record only..
+                        records.emplace_back();
+                    }
         }
-
-        if (x["type"] == "login")
+        else
         {
-            std::string token = x["token"];
-            if (!cc.get_database().has_user(token))
+            auto x = json::load(body);
+            if (x.get_type() != json::json_type::array)
             {
-                ws.send(json::json{{"type", "login"}, {"success", false}}.to_string());
+                res.result(boost::beast::http::status::bad_request);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", "An array of sensor values must be provided"}}.to_string();
                 return;
             }
+            for (size_t i = 0; i < x.size(); ++i)
+                records.push_back(std::move(x[i]));
+        }
 
-            auto &usr = cc.get_database().get_user(token);
-            if (std::find_if(usr.get_roots().begin(), usr.get_roots().end(), [this](const std::string &root)
-                             { return root == cc.get_database().get_root(); }) == usr.get_roots().end())
+        // the records are validated against the catalog, so the core mutex is taken only by the writer thread..
+        const auto c_catalog = get_catalog();
+        std::vector<std::pair<std::string, json::json>> values;
+        json::json j_results(json::json_type::array);
+        bool success = true;
+        for (auto &record : records)
+        {
+            if (record.get_type() == json::json_type::null)
             {
-                ws.close(boost::beast::websocket::close_code::bad_payload);
-                return;
+                success = false;
+                j_results.push_back({{"success", false}, {"message", "Malformed record"}});
+                continue;
+            }
+            if (record.get_type() != json::json_type::object || !record.has("sensor") || !record.has("value"))
+            {
+                success = false;
+                j_results.push_back({{"success", false}, {"message", "Records must contain sensor and value"}});
+                continue;
             }
 
-            ws_to_user[&ws] = usr.get_id();
-            user_to_ws[usr.get_id()] = &ws;
+            std::string sensor_id = record["sensor"];
+            auto s_it = c_catalog->find(sensor_id);
+            if (s_it == c_catalog->end())
+            {
+                success = false;
+                j_results.push_back({{"success", false}, {"message", "Sensor not found"}});
+                continue;
+            }
 
-            broadcast(json::json{{"type", "user_connected"}, {"user", ws_to_user[&ws]}}.to_string(), false);
-            ws.send(json::json{{"type", "login"}, {"success", true}, {"user", to_json(usr)}}.to_string());
-
-            // we send the sensor types
-            json::json j_sensor_types{{"type", "sensor_types"}};
-            json::json c_sensor_types(json::json_type::array);
-            for (const auto &st : cc.get_database().get_sensor_types())
-                c_sensor_types.push_back(to_json(st.get()));
-            j_sensor_types["sensor_types"] = std::move(c_sensor_types);
-            ws.send(j_sensor_types.to_string());
-
-            // we send the sensors
-            json::json j_sensors{{"type", "sensors"}};
-            json::json c_sensors(json::json_type::array);
-            for (const auto &s : cc.get_database().get_sensors())
-                c_sensors.push_back(to_json(s.get()));
-            j_sensors["sensors"] = std::move(c_sensors);
-            ws.send(j_sensors.to_string());
-
-            // we send the solvers
-            json::json j_solvers{{"type", "solvers"}};
-            json::json c_solvers(json::json_type::array);
-            for (const auto &cc_exec : cc.get_executors())
-                c_solvers.push_back({{"id", get_id(cc_exec->get_executor().get_solver())}, {"name", cc_exec->get_executor().get_name()}, {"state", ratio::executor::to_string(cc_exec->get_executor().get_state())}});
-            j_solvers["solvers"] = std::move(c_solvers);
-            ws.send(j_solvers.to_string());
-
-            for (const auto &cc_exec : cc.get_executors())
-            {
-                json::json j_sc = solver_state_changed_message(cc_exec->get_executor().get_solver());
-                j_sc["time"] = ratio::to_json(cc_exec->get_executor().get_current_time());
-                json::json j_executing(json::json_type::array);
-                for (const auto &atm : cc_exec->get_executor().get_executing())
-                    j_executing.push_back(get_id(*atm));
-                j_sc["executing"] = std::move(j_executing);
-                ws.send(j_sc.to_string());
-
-                json::json j_gr = to_graph(*cc_exec);
-                j_gr["type"] = "graph";
-                j_gr["solver_id"] = get_id(cc_exec->get_executor().get_solver());
-                ws.send(j_gr.to_string());
-            }
-
-            if (usr.get_data()["type"] == "admin")
-            {
-                json::json j_users{{"type", "users"}};
-                json::json c_users(json::json_type::array);
-                for (const auto &u : cc.get_database().get_users())
-                {
-                    json::json j_u = to_json(u.get());
-                    if (user_to_ws.count(u.get().get_id()))
-                        j_u["connected"] = true;
-                    c_users.push_back(std::move(j_u));
-                }
-                j_users["users"] = std::move(c_users);
-                ws.send(j_users.to_string());
+            if (auto err = validate_sensor_value(s_it->second, record["value"]))
+            {
+                success = false;
+                j_results.push_back({{"success", false}, {"message", *err}});
+                continue;
             }
 
-            broadcast(json::json{{"type", "user_connected"}, {"user", usr.get_id()}}.to_string(), false);
+            values.emplace_back(std::move(sensor_id), std::move(record["value"]));
+            j_results.push_back({{"success", true}});
         }
+
+        if (!values.empty() && !write_behind(res, std::move(values)))
+            return;
+
+        res.set(boost::beast::http::field::content_type, "application/json");
+        json::json j_res{{"success", success}};
+        j_res["results"] = std::move(j_results);
+        res.body() = j_res.to_string();
     }
 
-    void coco_gui::on_ws_error(network::websocket_session &ws, const boost::system::error_code &)
+    bool coco_gui::write_behind(network::response &res, std::vector<std::pair<std::string, json::json>> &&values)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        if (ws_to_user.count(&ws))
+        auto request = std::make_shared<write_request>();
+        auto written = request->written.get_future();
         {
-            if (user_to_ws.count(ws_to_user[&ws]))
-                user_to_ws.erase(ws_to_user[&ws]);
-            ws_to_user.erase(&ws);
+            std::lock_guard<std::mutex> _(values_mtx);
+            if (!writing || pending_values.size() + values.size() > COCO_WRITE_QUEUE)
+            { // the database does not keep up (or we are leaving), the client has to slow down..
+                res.result(boost::beast::http::status::service_unavailable);
+                res.set(boost::beast::http::field::retry_after, "1");
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = json::json{{"success", false}, {"message", "Too many sensor values waiting to be written"}}.to_string();
+                return false;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < values.size(); ++i)
+                pending_values.push_back({std::move(values[i].first), std::move(values[i].second), request, i + 1 == values.size(), now});
+            if (pending_values.size() == values.size()) // the writer waits only for an empty queue..
+                values_cv.notify_one();
+        }
+
+        if (durability == write_durability::committed && !written.get())
+        {
+            res.result(boost::beast::http::status::internal_server_error);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "The sensor values could not be written"}}.to_string();
+            return false;
         }
-        broadcast(json::json{{"type", "user_disconnected"}, {"user", ws_to_user[&ws]}}.to_string(), false);
+        return true;
     }
 
-    void coco_gui::new_user(const user &u)
+    void coco_gui::write_values()
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "new_user"}, {"user", to_json(u)}}.to_string(), false);
+        std::vector<pending_value> batch;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(values_mtx);
+                values_cv.wait(lock, [this]
+                               { return !pending_values.empty() || !writing; });
+                if (pending_values.empty())
+                    return; // stopped, and drained..
+                // the values are taken from the queue a chunk at a time, each of them being written on its own..
+                const auto n = std::min<std::size_t>(pending_values.size(), COCO_WRITE_BATCH_SIZE);
+                batch.assign(std::make_move_iterator(pending_values.begin()), std::make_move_iterator(pending_values.begin() + n));
+                pending_values.erase(pending_values.begin(), pending_values.begin() + n);
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            auto &site = metrics.lock_sites.get("write_values");
+            for (auto &v : batch)
+            {
+                metrics.write_delay.observe(now - v.queued);
+                try
+                { // the core mutex is released between the values, so that a large batch does not hold up the solvers and the other requests..
+                    const core_lock _(cc.get_mutex(), site);
+                    if (cc.get_database().has_sensor(v.sensor_id)) // the sensor might have been removed meanwhile..
+                        cc.publish_sensor_value(cc.get_database().get_sensor(v.sensor_id), v.value);
+                    else
+                        v.request->ok = false;
+                }
+                catch (const std::exception &e)
+                {
+                    LOG_WARN("Cannot write the value of sensor " << v.sensor_id << ": " << e.what());
+                    v.request->ok = false;
+                }
+                if (v.last) // the request is answered as soon as its own values are written..
+                    v.request->written.set_value(v.request->ok);
+            }
+            batch.clear();
+        }
     }
-    void coco_gui::updated_user(const user &u)
+
+    std::optional<std::string> coco_gui::validate_sensor_value(const std::map<std::string, parameter_type> &parameters, json::json &value)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "updated_user"}, {"user", to_json(u)}}.to_string(), false);
+        if (value.get_type() != json::json_type::object)
+            return "Sensor values must be objects";
+        for (auto &[name, val] : value.get_object())
+        {
+            auto p_it = parameters.find(name);
+            if (p_it == parameters.end())
+                return "Unknown parameter " + name;
+            switch (p_it->second)
+            {
+            case coco::parameter_type::Integer:
+            case coco::parameter_type::Float:
+                if (val.get_type() != json::json_type::number)
+                    return "Parameter " + name + " must be a number";
+                break;
+            case coco::parameter_type::Boolean:
+                if (val.get_type() != json::json_type::boolean)
+                    return "Parameter " + name + " must be a boolean";
+                break;
+            case coco::parameter_type::Symbol:
+            case coco::parameter_type::String:
+                if (val.get_type() != json::json_type::string)
+                    return "Parameter " + name + " must be a string";
+                break;
+            }
+        }
+        return std::nullopt;
     }
-    void coco_gui::removed_user(const user &u)
+
+    void coco_gui::get_sessions(network::request &req, network::response &res)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "removed_user"}, {"user", u.get_id()}}.to_string(), false);
+        if (!authorize(req, res, true))
+            return;
+
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = sessions_message().to_string();
     }
 
-    void coco_gui::new_sensor_type(const sensor_type &st)
+    void coco_gui::get_metrics(network::request &req, network::response &res)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "new_sensor_type"}, {"sensor_type", to_json(st)}}.to_string());
+        if (!authorize(req, res, true))
+            return;
+
+        std::string body;
+        metrics.write(body);
+
+        const auto c_sessions = std::atomic_load(&sessions);
+        body += "# HELP coco_gui_sessions The connected sessions.\n# TYPE coco_gui_sessions gauge\ncoco_gui_sessions " + std::to_string(c_sessions->size()) + '\n';
+        std::string queued = "# HELP coco_gui_session_queue_depth The messages sent to each session and not yet acknowledged.\n# TYPE coco_gui_session_queue_depth gauge\n";
+        std::string held = "# HELP coco_gui_session_held_messages The messages held for each session over its high-water mark.\n# TYPE coco_gui_session_held_messages gauge\n";
+        for (const auto &[ws, s] : *c_sessions)
+        { // sessions are labelled by a serial number, since user ids double as tokens..
+            std::lock_guard<std::mutex> _(s->mtx);
+            queued += "coco_gui_session_queue_depth{session=\"" + std::to_string(s->id) + "\"} " + std::to_string(s->in_flight.size()) + '\n';
+            held += "coco_gui_session_held_messages{session=\"" + std::to_string(s->id) + "\"} " + std::to_string(s->held.size()) + '\n';
+        }
+        body += queued + held;
+
+        body += "# HELP coco_gui_ready Whether the core is initialized and the API served.\n# TYPE coco_gui_ready gauge\ncoco_gui_ready " + std::string(ready ? "1" : "0") + '\n';
+        const auto since_launch = [&body](const std::string &name, const std::string &help, const long long us)
+        {
+            if (us >= 0)
+                body += "# HELP " + name + ' ' + help + "\n# TYPE " + name + " gauge\n" + name + ' ' + std::to_string(us / 1e6) + '\n';
+        };
+        since_launch("coco_gui_time_to_ready_seconds", "The time from the launch of the server to its readiness.", ready_us);
+        since_launch("coco_gui_time_to_first_response_seconds", "The time from the launch of the server to its first HTTP response.", first_response_us);
+        {
+            std::lock_guard<std::mutex> _(startup_mtx);
+            if (!startup_phases.empty())
+                body += "# HELP coco_gui_startup_phase_seconds The time taken by each startup phase.\n# TYPE coco_gui_startup_phase_seconds gauge\n";
+            for (const auto &[phase, seconds] : startup_phases)
+                body += "coco_gui_startup_phase_seconds{phase=\"" + phase + "\"} " + std::to_string(seconds) + '\n';
+        }
+
+        res.set(boost::beast::http::field::content_type, "text/plain; version=0.0.4");
+        res.body() = std::move(body);
     }
-    void coco_gui::updated_sensor_type(const sensor_type &s)
+
+    void coco_gui::get_ready(network::request &, network::response &res)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "updated_sensor_type"}, {"sensor_type", to_json(s)}}.to_string());
+        if (!ready)
+        {
+            res.result(boost::beast::http::status::service_unavailable);
+            res.set(boost::beast::http::field::retry_after, "1");
+        }
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = json::json{{"ready", ready.load()}}.to_string();
     }
-    void coco_gui::removed_sensor_type(const sensor_type &s)
+
+    void coco_gui::set_ready(const bool r)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "removed_sensor_type"}, {"sensor_type", s.get_id()}}.to_string());
+        if (!r)
+        {
+            ready = false;
+            return;
+        }
+        ready_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - launched).count();
+        ready = true;
+        LOG_DEBUG("coco_gui ready in " << ready_us / 1000 << " ms..");
+
+        if (upstream)
+            return; // a relay fetches the lists of its primary on demand, rather than holding up the relay thread..
+
+        // the cached responses are built by this (background) thread, rather than by the first requests..
+        get_cached(users_cache, [this]()
+                   { return users_message(); });
+        get_cached(sensor_types_cache, [this]()
+                   { return sensor_types_message(); });
+        sensors_response();
+        get_catalog();
+    }
+
+    void coco_gui::startup_phase(const std::string &phase, const std::chrono::steady_clock::duration &d)
+    {
+        std::lock_guard<std::mutex> _(startup_mtx);
+        startup_phases.emplace_back(phase, std::chrono::duration<double>(d).count());
+    }
+
+    void coco_gui::get_lock_profile(network::request &req, network::response &res)
+    {
+        if (!authorize(req, res, true))
+            return;
+
+        const std::string_view target(req.target().data(), req.target().size());
+        const auto m = query_params(query_of(target)).get("metric").value_or("hold");
+        if (m != "hold" && m != "wait" && m != "count")
+        {
+            res.result(boost::beast::http::status::bad_request);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = json::json{{"success", false}, {"message", "The metric must be one of hold, wait or count"}}.to_string();
+            return;
+        }
+
+        std::string body;
+        lock_profiler::write(body, metrics.lock_sites, m == "wait" ? lock_profiler::metric::wait : m == "count" ? lock_profiler::metric::count : lock_profiler::metric::hold);
+        res.set(boost::beast::http::field::content_type, "text/plain");
+        res.body() = std::move(body);
+    }
+    void coco_gui::update_lock_profile(network::request &req, network::response &res)
+    {
+        if (!authorize(req, res, true))
+            return;
+
+        auto x = json::load(boost::beast::buffers_to_string(req.body().data()));
+        if (x.has("reset") && static_cast<bool>(x["reset"]))
+            lock_profiler::reset();
+        if (x.has("enabled"))
+        {
+            if (static_cast<bool>(x["enabled"]))
+                lock_profiler::start();
+            else
+                lock_profiler::stop();
+        }
+
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = json::json{{"success", true}, {"enabled", lock_profiler::enabled()}}.to_string();
+    }
+
+    void coco_gui::on_ws_open(network::websocket_session &ws)
+    {
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("on_ws_open"));
+        ws_to_user[&ws] = "";
+    }
+
+    void coco_gui::on_ws_message(network::websocket_session &ws, const std::string &msg)
+    {
+        auto x = json::load(msg);
+        if (x.get_type() != json::json_type::object || !x.get_object().count("type") || !x.get_object().count("token"))
+        {
+            ws.close(boost::beast::websocket::close_code::bad_payload);
+            return;
+        }
+
+        if (x["type"] == "ack")
+        { // acknowledgements are handled without taking the core mutex..
+            if (!x.has("received") || x["received"].get_type() != json::json_type::number || static_cast<long>(x["received"]) < 0)
+            {
+                ws.close(boost::beast::websocket::close_code::bad_payload);
+                return;
+            }
+            acknowledge(ws, static_cast<long>(x["received"]));
+            return;
+        }
+        if (x["type"] == "subscribe" || x["type"] == "unsubscribe")
+        {
+            subscribe(ws, x, x["type"] == "subscribe");
+            return;
+        }
+        if (x["type"] == "subscribe_all")
+        {
+            subscribe_all(ws, x);
+            return;
+        }
+
+        if (!ready)
+        { // the client retries once the core is initialized..
+            ws.close(boost::beast::websocket::close_code::try_again_later);
+            return;
+        }
+        if (upstream)
+        { // the token is checked by the primary, without holding the core mutex..
+            if (x["type"] == "login")
+                relay_login(ws, x);
+            return;
+        }
+
+        const core_lock _(cc.get_mutex(), on_ws_message_site);
+        if (x["type"] == "login")
+        {
+            std::string token = x["token"];
+            if (guest_logins)
+            { // the token names the guest, which receives the broadcast messages only..
+                ws_to_user[&ws] = token;
+                user_to_ws[token] = &ws;
+                auto s = add_session(ws, token, false, x.has("format") && x["format"] == "msgpack" ? wire_format::msgpack : wire_format::json, x.has("compress") && static_cast<bool>(x["compress"]));
+                sync(s, {json::json{{"type", "login"}, {"success", true}, {"user", {{"id", token}}}}.to_string()});
+                return;
+            }
+            if (!cc.get_database().has_user(token))
+            {
+                ws.send(json::json{{"type", "login"}, {"success", false}}.to_string());
+                return;
+            }
+
+            auto &usr = cc.get_database().get_user(token);
+            if (std::find_if(usr.get_roots().begin(), usr.get_roots().end(), [this](const std::string &root)
+                             { return root == cc.get_database().get_root(); }) == usr.get_roots().end())
+            {
+                ws.close(boost::beast::websocket::close_code::bad_payload);
+                return;
+            }
+
+            const bool admin = usr.get_data()["type"] == "admin";
+            const bool relay = x.has("relay") && static_cast<bool>(x["relay"]);
+            if (relay && !admin)
+            { // only the admins can subscribe to the whole stream..
+                ws.close(boost::beast::websocket::close_code::policy_error);
+                return;
+            }
+
+            ws_to_user[&ws] = usr.get_id();
+            user_to_ws[usr.get_id()] = &ws;
+            invalidate(users_cache); // the users list shows the connected users..
+            auto s = add_session(ws, usr.get_id(), admin, x.has("format") && x["format"] == "msgpack" ? wire_format::msgpack : wire_format::json, x.has("compress") && static_cast<bool>(x["compress"]), relay);
+
+            std::vector<std::string> frames{json::json{{"type", "login"}, {"success", true}, {"user", to_json(usr)}}.to_string()};
+            snapshot(frames, admin, parse_versions(x)); // the graph versions already known by the client, if it is reconnecting..
+            sync(s, std::move(frames));
+
+            broadcast(json::json{{"type", "user_connected"}, {"user", usr.get_id()}}.to_string(), false);
+        }
+    }
+
+    void coco_gui::snapshot(std::vector<std::string> &frames, bool admin, const std::unordered_map<std::string, std::pair<long, long>> &versions)
+    {
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("snapshot"));
+
+        // we send the sensor types
+        frames.push_back(get_cached(sensor_types_cache, [this]()
+                                    { return sensor_types_message(); })
+                             ->body);
+
+        // we send the sensors
+        frames.push_back(sensors_response()
+                             ->body);
+
+        // we send the solvers
+        json::json j_solvers{{"type", "solvers"}};
+        json::json c_solvers(json::json_type::array);
+        for (const auto &cc_exec : cc.get_executors())
+            c_solvers.push_back({{"id", get_id(cc_exec->get_executor().get_solver())}, {"name", cc_exec->get_executor().get_name()}, {"state", ratio::executor::to_string(cc_exec->get_executor().get_state())}});
+        j_solvers["solvers"] = std::move(c_solvers);
+        frames.push_back(j_solvers.to_string());
+
+        for (const auto &cc_exec : cc.get_executors())
+            solver_snapshot(frames, *cc_exec, versions);
+
+        if (admin)
+            frames.push_back(get_cached(users_cache, [this]()
+                                        { return users_message(); })
+                                 ->body);
+    }
+
+    void coco_gui::with_snapshot(std::vector<std::string> &&frames, bool admin, const std::unordered_map<std::string, std::pair<long, long>> &versions, lock_site &site, const std::function<void(std::vector<std::string> &&)> &then)
+    {
+        if (!upstream)
+        {
+            const core_lock _(cc.get_mutex(), site);
+            snapshot(frames, admin, versions);
+            then(std::move(frames));
+            return;
+        }
+
+        while (true)
+        { // the lists might be older than the stream, should it change them while they are fetched..
+            const auto changes = relayed_list_changes.load();
+            const auto lists = fetch_relayed_lists(admin);
+            const core_lock _(cc.get_mutex(), site);
+            if (changes != relayed_list_changes)
+                continue;
+            relayed_snapshot(frames, lists, versions);
+            then(std::move(frames));
+            return;
+        }
+    }
+
+    void coco_gui::solver_snapshot(std::vector<std::string> &frames, const coco_executor &exec, const std::unordered_map<std::string, std::pair<long, long>> &versions)
+    {
+        json::json j_sc = solver_state_changed_message(exec.get_executor().get_solver());
+        j_sc["time"] = ratio::to_json(exec.get_executor().get_current_time());
+        json::json j_executing(json::json_type::array);
+        for (const auto &atm : exec.get_executor().get_executing())
+            j_executing.push_back(get_id(*atm));
+        j_sc["executing"] = std::move(j_executing);
+        frames.push_back(j_sc.to_string());
+
+        graph_snapshot(frames, get_graph(exec), versions);
+    }
+
+    void coco_gui::graph_snapshot(std::vector<std::string> &frames, graph_model &gr, const std::unordered_map<std::string, std::pair<long, long>> &versions)
+    {
+        std::optional<std::string> deltas;
+        if (auto v_it = versions.find(gr.get_solver_id()); v_it != versions.end())
+            deltas = gr.deltas(v_it->second.first, v_it->second.second);
+        if (!deltas)
+            frames.push_back(gr.snapshot());
+        else if (!deltas->empty())
+            frames.push_back(std::move(*deltas));
+    }
+
+    std::unordered_map<std::string, std::pair<long, long>> coco_gui::parse_versions(json::json &x)
+    {
+        std::unordered_map<std::string, std::pair<long, long>> versions;
+        if (x.has("versions"))
+            for (size_t i = 0; i < x["versions"].size(); ++i)
+                versions[x["versions"][i]["solver_id"].to_string()] = {static_cast<long>(x["versions"][i]["epoch"]), static_cast<long>(x["versions"][i]["version"])};
+        return versions;
+    }
+
+    void coco_gui::subscribe(network::websocket_session &ws, json::json &x, bool sub)
+    {
+        auto y = std::make_shared<session_sync>();
+        y->subscription = true;
+        std::unordered_set<std::string> new_solvers;
+        {
+            std::lock_guard<std::mutex> _(sessions_mtx);
+            const auto c_sessions = std::atomic_load(&sessions);
+            auto it = c_sessions->find(&ws);
+            if (it == c_sessions->end())
+                return; // the client has not logged in yet..
+            y->session = it->second;
+            for (const auto &[kind, key] : {std::make_pair("solver", "solvers"), std::make_pair("sensor", "sensors"), std::make_pair("sensor_type", "sensor_types")})
+                if (x.has(key))
+                    for (size_t i = 0; i < x[key].size(); ++i)
+                    {
+                        auto t = topic(kind, x[key][i]);
+                        if (sub && y->session->filtered && !y->session->topics.count(t) && std::string(kind) == "solver") // an unfiltered session already has every solver..
+                            new_solvers.insert(t);
+                        (sub ? y->subscribed : y->unsubscribed).push_back(std::move(t));
+                    }
+        }
+
+        if (new_solvers.empty())
+        {
+            sync(std::move(y));
+            return;
+        }
+        // the client might have missed some events of the newly subscribed solvers, so we catch it up at the point the subscriptions take effect..
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("subscribe"));
+        const auto versions = parse_versions(x);
+        for (auto &[id, slv] : relayed_solvers)
+            if (new_solvers.count("solver:" + id))
+                relayed_solver_snapshot(y->frames, slv, versions);
+        for (const auto &cc_exec : cc.get_executors())
+            if (new_solvers.count(solver_topic(*cc_exec)))
+                solver_snapshot(y->frames, *cc_exec, versions);
+        sync(std::move(y));
+    }
+
+    void coco_gui::subscribe_all(network::websocket_session &ws, json::json &x)
+    {
+        auto y = std::make_shared<session_sync>();
+        y->subscription = y->unfiltered = true;
+        {
+            std::lock_guard<std::mutex> _(sessions_mtx);
+            const auto c_sessions = std::atomic_load(&sessions);
+            auto it = c_sessions->find(&ws);
+            if (it == c_sessions->end())
+                return; // the client has not logged in yet..
+            y->session = it->second;
+        }
+
+        // the session missed the messages of the topics it was not subscribed to, hence it gets the whole state again..
+        try
+        {
+            with_snapshot(std::move(y->frames), y->session->admin, parse_versions(x), metrics.lock_sites.get("subscribe"), [this, &y](std::vector<std::string> &&frames)
+                          {
+                              y->frames = std::move(frames);
+                              sync(std::move(y)); });
+        }
+        catch (const upstream_error &e)
+        { // the client reconnects once the primary is back..
+            LOG_WARN("Cannot send the snapshot to session " << y->session->id << ": " << e.what());
+            y->session->ws.close(boost::beast::websocket::close_code::try_again_later);
+        }
+    }
+
+    std::shared_ptr<const coco_gui::subscription_index> coco_gui::index_subscriptions(const session_registry &registry)
+    {
+        auto index = std::make_shared<subscription_index>();
+        for (const auto &[ws, s] : registry)
+            if (!s->filtered)
+                index->unfiltered.push_back(s);
+            else
+                for (const auto &t : s->topics)
+                    index->subscribers[t].push_back(s);
+        return index;
+    }
+
+    json::json coco_gui::users_message()
+    {
+        if (upstream)
+            return upstream_list("/users");
+        json::json j_users{{"type", "users"}};
+        json::json c_users(json::json_type::array);
+        for (const auto &u : cc.get_database().get_users())
+        {
+            json::json j_u = to_json(u.get());
+            if (user_to_ws.count(u.get().get_id()))
+                j_u["connected"] = true;
+            c_users.push_back(std::move(j_u));
+        }
+        j_users["users"] = std::move(c_users);
+        return j_users;
+    }
+
+    json::json coco_gui::sensor_types_message()
+    {
+        if (upstream)
+            return upstream_list("/sensor_types");
+        json::json j_sensor_types{{"type", "sensor_types"}};
+        json::json c_sensor_types(json::json_type::array);
+        for (const auto &st : cc.get_database().get_sensor_types())
+            c_sensor_types.push_back(to_json(st.get()));
+        j_sensor_types["sensor_types"] = std::move(c_sensor_types);
+        return j_sensor_types;
+    }
+
+    std::shared_ptr<const coco_gui::cached_response> coco_gui::sensors_response()
+    {
+        if (upstream)
+            return get_cached(sensors_cache, [this]()
+                              { return upstream_list("/sensors"); });
+        if (auto c = std::atomic_load(&sensors_cache))
+            return c;
+
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("sensors_response"));
+        if (auto c = std::atomic_load(&sensors_cache))
+            return c;
+        if (!sensor_entries_built)
+        {
+            sensor_entries.clear();
+            sensor_entries_index.clear();
+            for (const auto &sns : cc.get_database().get_sensors())
+            {
+                sensor_entries_index.emplace(sns.get().get_id(), sensor_entries.size());
+                sensor_entries.push_back({&sns.get(), to_json(sns.get()).to_string(), false});
+            }
+            sensor_entries_built = true;
+        }
+        else // only the sensors with new values or states are serialized again..
+            for (const auto i : dirty_sensor_entries)
+            {
+                sensor_entries[i].body = to_json(*sensor_entries[i].sns).to_string();
+                sensor_entries[i].dirty = false;
+            }
+        dirty_sensor_entries.clear();
+
+        std::size_t capacity = 64;
+        for (const auto &e : sensor_entries)
+            capacity += e.body.size() + 1;
+        json_writer w(capacity);
+        w.begin_object().key("type").value("sensors").key("sensors").begin_array();
+        for (const auto &e : sensor_entries)
+            w.raw(e.body);
+        w.end_array().end_object();
+        auto body = w.release();
+        auto c = std::make_shared<const cached_response>(cached_response{etag(body), std::move(body)});
+        std::atomic_store(&sensors_cache, c);
+        return c;
+    }
+
+    void coco_gui::touch_sensor(const sensor &s)
+    {
+        if (auto it = sensor_entries_index.find(s.get_id()); it != sensor_entries_index.end() && !sensor_entries[it->second].dirty)
+        {
+            sensor_entries[it->second].dirty = true;
+            dirty_sensor_entries.push_back(it->second);
+        }
+        invalidate(sensors_cache);
+    }
+
+    void coco_gui::reset_sensors()
+    {
+        sensor_entries_built = false;
+        invalidate(sensors_cache);
+    }
+
+    std::shared_ptr<const coco_gui::sensor_catalog> coco_gui::get_catalog()
+    {
+        if (auto c = std::atomic_load(&catalog))
+            return c;
+
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("get_catalog"));
+        if (auto c = std::atomic_load(&catalog))
+            return c;
+        auto c = std::make_shared<sensor_catalog>();
+        for (const auto &sns : cc.get_database().get_sensors())
+            c->emplace(sns.get().get_id(), sns.get().get_type().get_parameters());
+        std::shared_ptr<const sensor_catalog> c_catalog = std::move(c);
+        std::atomic_store(&catalog, c_catalog);
+        return c_catalog;
+    }
+
+    std::shared_ptr<const coco_gui::cached_response> coco_gui::get_cached(std::shared_ptr<const cached_response> &cache, const std::function<json::json()> &build)
+    {
+        if (auto c = std::atomic_load(&cache))
+            return c;
+
+        if (upstream)
+        { // a relay fetches the list from its primary without holding the core mutex, keeping it only if no list was invalidated meanwhile..
+            const auto generation = invalidations.load();
+            auto body = build().to_string();
+            auto c = std::make_shared<const cached_response>(cached_response{etag(body), std::move(body)});
+            const core_lock _(cc.get_mutex(), metrics.lock_sites.get("get_cached")); // the relay thread invalidates the caches while holding the core mutex..
+            if (generation == invalidations)
+                std::atomic_store(&cache, c);
+            return c;
+        }
+
+        // the listener callbacks, which invalidate the caches, run while holding the core mutex..
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("get_cached"));
+        if (auto c = std::atomic_load(&cache))
+            return c;
+        auto body = build().to_string();
+        auto c = std::make_shared<const cached_response>(cached_response{etag(body), std::move(body)});
+        std::atomic_store(&cache, c);
+        return c;
+    }
+
+    void coco_gui::invalidate(std::shared_ptr<const cached_response> &cache)
+    {
+        invalidations++;
+        std::atomic_store(&cache, std::shared_ptr<const cached_response>());
+    }
+
+    void coco_gui::respond(network::request &req, network::response &res, const cached_response &c)
+    {
+        res.set(boost::beast::http::field::etag, c.etag);
+        if (not_modified(req, c.etag))
+        {
+            res.result(boost::beast::http::status::not_modified);
+            return;
+        }
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = c.body;
+    }
+
+    std::string coco_gui::etag(const std::string &body)
+    { // a 64-bit FNV-1a hash of the body..
+        std::uint64_t h = 14695981039346656037ull;
+        for (const auto &c : body)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        std::stringstream ss;
+        ss << '"' << std::hex << std::setw(16) << std::setfill('0') << h << '"';
+        return ss.str();
+    }
+
+    void coco_gui::on_ws_error(network::websocket_session &ws, const boost::system::error_code &)
+    {
+        const core_lock _(cc.get_mutex(), metrics.lock_sites.get("on_ws_error"));
+        remove_session(ws);
+        std::string user_id;
+        if (ws_to_user.count(&ws))
+        {
+            user_id = ws_to_user[&ws];
+            if (user_to_ws.count(user_id) && user_to_ws[user_id] == &ws)
+                user_to_ws.erase(user_id);
+            ws_to_user.erase(&ws);
+            invalidate(users_cache);
+        }
+        broadcast(json::json{{"type", "user_disconnected"}, {"user", user_id}}.to_string(), false);
+    }
+
+    void coco_gui::new_user(const user &u)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.new_user.site);
+        callbacks.new_user.messages.inc();
+        invalidate(users_cache);
+        broadcast(json::json{{"type", "new_user"}, {"user", to_json(u)}}.to_string(), false);
+    }
+    void coco_gui::updated_user(const user &u)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.updated_user.site);
+        callbacks.updated_user.messages.inc();
+        invalidate(users_cache);
+        forget_principal(u.get_id());
+        broadcast(json::json{{"type", "updated_user"}, {"user", to_json(u)}}.to_string(), false);
+    }
+    void coco_gui::removed_user(const user &u)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.removed_user.site);
+        callbacks.removed_user.messages.inc();
+        invalidate(users_cache);
+        forget_principal(u.get_id());
+        broadcast(json::json{{"type", "removed_user"}, {"user", u.get_id()}}.to_string(), false);
+    }
+
+    void coco_gui::new_sensor_type(const sensor_type &st)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.new_sensor_type.site);
+        callbacks.new_sensor_type.messages.inc();
+        invalidate(sensor_types_cache);
+        broadcast(json::json{{"type", "new_sensor_type"}, {"sensor_type", to_json(st)}}.to_string());
+    }
+    void coco_gui::updated_sensor_type(const sensor_type &s)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.updated_sensor_type.site);
+        callbacks.updated_sensor_type.messages.inc();
+        invalidate(sensor_types_cache);
+        std::atomic_store(&catalog, std::shared_ptr<const sensor_catalog>());
+        {
+            std::lock_guard<std::mutex> rv_lock(recent_values_mtx);
+            recent_values.clear(); // the parameters of the buffered values might have changed..
+        }
+        broadcast(json::json{{"type", "updated_sensor_type"}, {"sensor_type", to_json(s)}}.to_string());
+    }
+    void coco_gui::removed_sensor_type(const sensor_type &s)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.removed_sensor_type.site);
+        callbacks.removed_sensor_type.messages.inc();
+        invalidate(sensor_types_cache);
+        broadcast(json::json{{"type", "removed_sensor_type"}, {"sensor_type", s.get_id()}}.to_string());
     }
 
     void coco_gui::new_sensor(const sensor &s)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        const core_lock _(cc.get_mutex(), callbacks.new_sensor.site);
+        callbacks.new_sensor.messages.inc();
+        reset_sensors();
+        std::atomic_store(&catalog, std::shared_ptr<const sensor_catalog>());
         broadcast(json::json{{"type", "new_sensor"}, {"sensor", to_json(s)}}.to_string());
     }
     void coco_gui::updated_sensor(const sensor &s)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        const core_lock _(cc.get_mutex(), callbacks.updated_sensor.site);
+        callbacks.updated_sensor.messages.inc();
+        touch_sensor(s);
+        std::atomic_store(&catalog, std::shared_ptr<const sensor_catalog>());
         broadcast(json::json{{"type", "updated_sensor"}, {"sensor", to_json(s)}}.to_string());
     }
     void coco_gui::removed_sensor(const sensor &s)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        const core_lock _(cc.get_mutex(), callbacks.removed_sensor.site);
+        callbacks.removed_sensor.messages.inc();
+        reset_sensors();
+        std::atomic_store(&catalog, std::shared_ptr<const sensor_catalog>());
+        {
+            std::lock_guard<std::mutex> rv_lock(recent_values_mtx);
+            recent_values.erase(s.get_id());
+        }
         broadcast(json::json{{"type", "removed_sensor"}, {"sensor", s.get_id()}}.to_string());
     }
 
     void coco_gui::new_sensor_value(const sensor &s, const std::chrono::system_clock::time_point &time, const json::json &value)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "new_sensor_value"}, {"sensor", s.get_id()}, {"timestamp", std::chrono::system_clock::to_time_t(time)}, {"value", value}}.to_string());
+        const core_lock _(cc.get_mutex(), callbacks.new_sensor_value.site);
+        callbacks.new_sensor_value.messages.inc();
+        touch_sensor(s);
+        {
+            std::lock_guard<std::mutex> rv_lock(recent_values_mtx);
+            const long timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+            auto it = recent_values.find(s.get_id());
+            if (it != recent_values.end() && !it->second->empty() && it->second->back_timestamp() > timestamp)
+            { // the values are no longer in order, we let the database answer the queries for this sensor..
+                recent_values.erase(it);
+                it = recent_values.end();
+            }
+            else if (it == recent_values.end())
+            {
+                auto c_it = recent_values_capacity.find(s.get_type().get_id());
+                if (const auto capacity = c_it != recent_values_capacity.end() ? c_it->second : COCO_RECENT_VALUES; capacity)
+                    it = recent_values.emplace(s.get_id(), std::make_unique<sensor_series>(s.get_type().get_parameters(), capacity)).first;
+            }
+            if (it != recent_values.end())
+            {
+                json::json val = value;
+                it->second->push_back(timestamp, val);
+            }
+        }
+        json_writer w;
+        w.begin_object().key("type").value("new_sensor_value").key("sensor").value(s.get_id()).key("timestamp").value(std::chrono::system_clock::to_time_t(time)).key("value").value(value).end_object();
+        broadcast(w.release(), true, update_key('v', &s), {topic("sensor", s.get_id()), topic("sensor_type", s.get_type().get_id())});
     }
     void coco_gui::new_sensor_state(const sensor &s, const std::chrono::system_clock::time_point &time, const json::json &state)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(json::json{{"type", "new_sensor_state"}, {"sensor", s.get_id()}, {"timestamp", std::chrono::system_clock::to_time_t(time)}, {"state", state}}.to_string());
+        const core_lock _(cc.get_mutex(), callbacks.new_sensor_state.site);
+        callbacks.new_sensor_state.messages.inc();
+        touch_sensor(s);
+        json_writer w;
+        w.begin_object().key("type").value("new_sensor_state").key("sensor").value(s.get_id()).key("timestamp").value(std::chrono::system_clock::to_time_t(time)).key("state").value(state).end_object();
+        broadcast(w.release(), true, update_key('s', &s), {topic("sensor", s.get_id()), topic("sensor_type", s.get_type().get_id())});
     }
 
     void coco_gui::new_solver(const coco_executor &exec)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        const core_lock _(cc.get_mutex(), callbacks.new_solver.site);
+        callbacks.new_solver.messages.inc();
+        get_graph(exec);
         broadcast(solver_created_message(exec.get_executor()).to_string());
     }
     void coco_gui::removed_solver(const coco_executor &exec)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
+        const core_lock _(cc.get_mutex(), callbacks.removed_solver.site);
+        callbacks.removed_solver.messages.inc();
+        flush_batch(&exec);
+        {
+            std::lock_guard<std::mutex> b_lock(batches_mtx);
+            batches.erase(&exec);
+        }
+        graphs.erase(&exec);
+        executions.erase(&exec);
         broadcast(solver_destroyed_message(exec.get_executor()).to_string());
     }
 
     void coco_gui::state_changed(const coco_executor &exec)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        json::json j_sc = solver_state_changed_message(exec.get_executor().get_solver());
-        j_sc["time"] = ratio::to_json(exec.get_executor().get_current_time());
-        json::json j_executing(json::json_type::array);
-        for (const auto &atm : exec.get_executor().get_executing())
-            j_executing.push_back(get_id(*atm));
-        j_sc["executing"] = std::move(j_executing);
-        broadcast(j_sc.to_string());
+        const core_lock _(cc.get_mutex(), callbacks.state_changed.site);
+        callbacks.state_changed.messages.inc();
+        auto &w = executions[&exec];
+        w.state = true;
+        conflate(exec, w);
     }
 
-    void coco_gui::flaw_created(const coco_executor &, const ratio::flaw &f)
+    void coco_gui::flaw_created(const coco_executor &exec, const ratio::flaw &f)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(flaw_created_message(f).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.flaw_created.site);
+        callbacks.flaw_created.messages.inc();
+        batch(exec, flaw_created_message(f));
     }
-    void coco_gui::flaw_state_changed(const coco_executor &, const ratio::flaw &f)
+    void coco_gui::flaw_state_changed(const coco_executor &exec, const ratio::flaw &f)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(flaw_state_changed_message(f).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.flaw_state_changed.site);
+        callbacks.flaw_state_changed.messages.inc();
+        batch(exec, flaw_state_changed_message(f), "flaw_state_changed", &f);
     }
-    void coco_gui::flaw_cost_changed(const coco_executor &, const ratio::flaw &f)
+    void coco_gui::flaw_cost_changed(const coco_executor &exec, const ratio::flaw &f)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(flaw_cost_changed_message(f).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.flaw_cost_changed.site);
+        callbacks.flaw_cost_changed.messages.inc();
+        batch(exec, flaw_cost_changed_message(f), "flaw_cost_changed", &f);
     }
-    void coco_gui::flaw_position_changed(const coco_executor &, const ratio::flaw &f)
+    void coco_gui::flaw_position_changed(const coco_executor &exec, const ratio::flaw &f)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(flaw_position_changed_message(f).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.flaw_position_changed.site);
+        callbacks.flaw_position_changed.messages.inc();
+        batch(exec, flaw_position_changed_message(f), "flaw_position_changed", &f);
     }
-    void coco_gui::current_flaw(const coco_executor &, const ratio::flaw &f)
+    void coco_gui::current_flaw(const coco_executor &exec, const ratio::flaw &f)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(current_flaw_message(f).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.current_flaw.site);
+        callbacks.current_flaw.messages.inc();
+        batch(exec, current_flaw_message(f), "current_flaw", &exec);
     }
 
-    void coco_gui::resolver_created(const coco_executor &, const ratio::resolver &r)
+    void coco_gui::resolver_created(const coco_executor &exec, const ratio::resolver &r)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(resolver_created_message(r).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.resolver_created.site);
+        callbacks.resolver_created.messages.inc();
+        batch(exec, resolver_created_message(r));
     }
-    void coco_gui::resolver_state_changed(const coco_executor &, const ratio::resolver &r)
+    void coco_gui::resolver_state_changed(const coco_executor &exec, const ratio::resolver &r)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(resolver_state_changed_message(r).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.resolver_state_changed.site);
+        callbacks.resolver_state_changed.messages.inc();
+        batch(exec, resolver_state_changed_message(r), "resolver_state_changed", &r);
     }
-    void coco_gui::current_resolver(const coco_executor &, const ratio::resolver &r)
+    void coco_gui::current_resolver(const coco_executor &exec, const ratio::resolver &r)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(current_resolver_message(r).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.current_resolver.site);
+        callbacks.current_resolver.messages.inc();
+        batch(exec, current_resolver_message(r), "current_resolver", &exec);
     }
 
-    void coco_gui::causal_link_added(const coco_executor &, const ratio::flaw &f, const ratio::resolver &r)
+    void coco_gui::causal_link_added(const coco_executor &exec, const ratio::flaw &f, const ratio::resolver &r)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(causal_link_added_message(f, r).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.causal_link_added.site);
+        callbacks.causal_link_added.messages.inc();
+        batch(exec, causal_link_added_message(f, r));
     }
 
     void coco_gui::executor_state_changed(const coco_executor &exec, ratio::executor::executor_state)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(executor_state_changed_message(exec.get_executor()).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.executor_state_changed.site);
+        callbacks.executor_state_changed.messages.inc();
+        if (auto it = executions.find(&exec); it != executions.end() && it->second.pending())
+            send_execution(exec, it->second); // the conflated updates precede the new state of the executor..
+        flush_batch(&exec);
+        broadcast(executor_state_changed_message(exec.get_executor()).to_string(), true, update_key('e', &exec), {solver_topic(exec)});
     }
 
     void coco_gui::tick(const coco_executor &exec, const utils::rational &time)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(tick_message(exec.get_executor(), time).to_string());
+        const core_lock _(cc.get_mutex(), callbacks.tick.site);
+        callbacks.tick.messages.inc();
+        auto &w = executions[&exec];
+        w.time = time; // consecutive ticks are merged into the latest one..
+        conflate(exec, w);
     }
 
-    void coco_gui::start(const coco_executor &exec, const std::unordered_set<ratio::atom *> &atoms)
+    /**
+     * @brief Returns the serialized elements of the array members of the given message (i.e., the atoms of a `start` or `end` message).
+     */
+    static std::unordered_set<std::string> atoms_of(json::json &msg)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(start_message(exec.get_executor(), atoms).to_string());
+        std::unordered_set<std::string> atoms;
+        for (auto &[name, value] : msg.get_object())
+            if (value.get_type() == json::json_type::array)
+                for (size_t i = 0; i < value.size(); ++i)
+                    atoms.insert(value[i].to_string());
+        return atoms;
     }
-    void coco_gui::end(const coco_executor &exec, const std::unordered_set<ratio::atom *> &atoms)
+    /**
+     * @brief Adds the atoms of the given message to the accumulated one.
+     */
+    static void add_atoms(std::optional<json::json> &acc, json::json &&msg)
+    {
+        if (!acc)
+        {
+            acc = std::move(msg);
+            return;
+        }
+        for (auto &[name, value] : msg.get_object())
+            if (value.get_type() == json::json_type::array)
+                for (size_t i = 0; i < value.size(); ++i)
+                    (*acc)[name].push_back(std::move(value[i]));
+    }
+    /**
+     * @brief Removes the given atoms from the accumulated message, dropping the message if no atom is left.
+     */
+    static void remove_atoms(std::optional<json::json> &acc, const std::unordered_set<std::string> &atoms)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        broadcast(end_message(exec.get_executor(), atoms).to_string());
+        if (!acc)
+            return;
+        bool empty = true;
+        for (auto &[name, value] : acc->get_object())
+            if (value.get_type() == json::json_type::array)
+            {
+                json::json c_value(json::json_type::array);
+                for (size_t i = 0; i < value.size(); ++i)
+                    if (!atoms.count(value[i].to_string()))
+                        c_value.push_back(std::move(value[i]));
+                empty &= c_value.size() == 0;
+                value = std::move(c_value);
+            }
+        if (empty)
+            acc.reset();
     }
 
-    void coco_gui::broadcast(const std::string &&msg, bool to_all)
+    void coco_gui::start(const coco_executor &exec, const std::unordered_set<ratio::atom *> &atoms)
     {
-        std::lock_guard<std::recursive_mutex> _(cc.get_mutex());
-        utils::c_ptr<network::message> m = new network::message(msg);
-        if (to_all)
-            for (auto &[tkn, conn] : user_to_ws)
-                conn->send(m);
+        const core_lock _(cc.get_mutex(), callbacks.start.site);
+        callbacks.start.messages.inc();
+        auto &w = executions[&exec];
+        auto msg = start_message(exec.get_executor(), atoms);
+        remove_atoms(w.ended, atoms_of(msg)); // the atoms which ended and started again, within the window, are still executing..
+        add_atoms(w.started, std::move(msg));
+        conflate(exec, w);
+    }
+    void coco_gui::end(const coco_executor &exec, const std::unordered_set<ratio::atom *> &atoms)
+    {
+        const core_lock _(cc.get_mutex(), callbacks.end.site);
+        callbacks.end.messages.inc();
+        auto &w = executions[&exec];
+        add_atoms(w.ended, end_message(exec.get_executor(), atoms)); // the ended atoms are sent after the started ones, so an atom starting and ending within the window is ended..
+        conflate(exec, w);
+    }
+
+    void coco_gui::conflate(const coco_executor &exec, execution_window &w)
+    {
+        const auto rate = execution_rate.load();
+        if (rate <= 0 || std::chrono::steady_clock::now() - w.sent >= std::chrono::duration<double>(1 / rate))
+            send_execution(exec, w);
+        else if (!executions_pending.exchange(true))
+            wake_fanout(); // the fan-out thread has to send the updates at the end of the window..
+    }
+
+    void coco_gui::send_execution(const coco_executor &exec, execution_window &w)
+    {
+        flush_batch(&exec); // the solver events precede the execution updates..
+        if (w.state)
+        { // the message is built once per window, however many times the state changed..
+            json::json j_sc = solver_state_changed_message(exec.get_executor().get_solver());
+            j_sc["time"] = ratio::to_json(exec.get_executor().get_current_time());
+            json::json j_executing(json::json_type::array);
+            for (const auto &atm : exec.get_executor().get_executing())
+                j_executing.push_back(get_id(*atm));
+            j_sc["executing"] = std::move(j_executing);
+            broadcast(j_sc.to_string(), true, update_key('c', &exec), {solver_topic(exec)});
+        }
+        if (w.started)
+            broadcast(w.started->to_string(), true, {}, {solver_topic(exec)});
+        if (w.ended)
+            broadcast(w.ended->to_string(), true, {}, {solver_topic(exec)});
+        if (w.time)
+            broadcast(tick_message(exec.get_executor(), *w.time).to_string(), true, update_key('t', &exec), {solver_topic(exec)});
+        w = {};
+        w.sent = std::chrono::steady_clock::now();
+    }
+
+    void coco_gui::flush_executions()
+    {
+        // the fan-out thread does not wait for the core, which might be busy solving, but tries again at the next period..
+        std::unique_lock<std::recursive_mutex> lock(cc.get_mutex(), std::try_to_lock);
+        if (!lock.owns_lock())
+            return;
+        const auto rate = execution_rate.load();
+        const auto due = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(rate > 0 ? 1 / rate : 0));
+        bool pending = false;
+        for (auto &[exec, w] : executions)
+            if (w.pending())
+            {
+                if (w.sent <= due)
+                    send_execution(*exec, w);
+                else
+                    pending = true;
+            }
+        executions_pending = pending;
+    }
+
+    std::size_t coco_gui::replay(const std::string &path, const double speed)
+    {
+        event_log_reader log(path);
+        std::unordered_map<std::string, char> solvers; // stand for the recorded solvers, their addresses keying the batches..
+        std::unordered_set<std::string> kinds;         // the kinds of the recorded solver events, which the batches refer to..
+        event_record r;
+        std::size_t n = 0;
+        const auto start = std::chrono::steady_clock::now();
+        while (log.next(r))
+        {
+            if (speed > 0)
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(r.time / speed));
+
+            const core_lock _(cc.get_mutex(), metrics.lock_sites.get("replay"));
+            switch (r.kind)
+            {
+            case event_kind::broadcast:
+                broadcast(std::move(r.payload), r.to_all, std::move(r.key), std::move(r.topics));
+                break;
+            case event_kind::solver_event:
+                batch(&solvers[r.solver_id], r.solver_id, std::move(r.payload), *kinds.insert(r.key).first, reinterpret_cast<const void *>(static_cast<std::uintptr_t>(r.item)));
+                break;
+            case event_kind::flush:
+                flush_batch(&solvers[r.solver_id]);
+                break;
+            }
+            n++;
+        }
+
+        for (auto &[id, solver] : solvers)
+        { // the stand-ins are going away, so are their batches..
+            flush_batch(&solver);
+            std::lock_guard<std::mutex> _(batches_mtx);
+            batches.erase(&solver);
+        }
+        return n;
+    }
+
+    void coco_gui::relay()
+    {
+        while (running)
+        {
+            try
+            {
+                upstream_link link(upstream->host, upstream->port);
+                // the relay tells the versions of the graphs it already has, so that the primary sends only the events it missed..
+                json::json j_login{{"type", "login"}, {"token", upstream->token}, {"ack", true}, {"relay", true}};
+                json::json j_versions(json::json_type::array);
+                {
+                    const core_lock _(cc.get_mutex(), relay_site);
+                    for (auto &[id, slv] : relayed_solvers)
+                        if (slv.graph)
+                            j_versions.push_back({{"solver_id", slv.info["id"]}, {"epoch", slv.epoch}, {"version", slv.version}});
+                }
+                j_login["versions"] = std::move(j_versions);
+                link.write(j_login.to_string());
+                LOG_DEBUG("Relaying " << upstream->host << ':' << upstream->port << "..");
+
+                std::size_t received = 0;
+                while (running)
+                {
+                    auto msg = link.read();
+                    {
+                        const core_lock _(cc.get_mutex(), relay_site);
+                        relay_message(std::move(msg));
+                    }
+                    if (++received % 32 == 0) // the primary keeps sending as long as the relay acknowledges..
+                        link.write(json::json{{"type", "ack"}, {"token", upstream->token}, {"received", static_cast<long>(received)}}.to_string());
+                    if (relay_synced && !ready)
+                        set_ready(true);
+                }
+            }
+            catch (const std::exception &e)
+            { // the sessions keep what they have, and are brought up to date once the primary is back..
+                LOG_WARN("Lost the primary server: " << e.what());
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    void coco_gui::relay_message(std::string &&msg)
+    {
+        auto x = json::load(msg);
+        const std::string type = x["type"];
+        auto &relayed = relayed_messages[type];
+        if (!relayed)
+            relayed = &metrics.messages.get("relay_" + type);
+        relayed->inc();
+        if (type == "login")
+        {
+            if (!static_cast<bool>(x["success"]))
+                throw upstream_error("The primary server refused the relay token");
+        }
+        else if (type == "users" || type == "new_user" || type == "updated_user" || type == "removed_user" || type == "user_connected" || type == "user_disconnected")
+        {
+            relayed_list_changes++;
+            if (type == "users")
+                relay_synced = true; // the users list closes the snapshot the primary sends to its admins..
+            else if (type == "updated_user" || type == "removed_user")
+            {
+                std::string user_id = type == "updated_user" ? x["user"]["id"] : x["user"];
+                forget_principal(user_id);
+            }
+            invalidate(users_cache);
+            broadcast(std::move(msg), false);
+        }
+        else if (type == "sensor_types" || type == "new_sensor_type" || type == "updated_sensor_type" || type == "removed_sensor_type")
+        {
+            relayed_list_changes++;
+            invalidate(sensor_types_cache);
+            broadcast(std::move(msg));
+        }
+        else if (type == "sensors" || type == "new_sensor" || type == "updated_sensor" || type == "removed_sensor")
+        {
+            relayed_list_changes++;
+            if (type == "sensors")
+            {
+                relayed_sensor_types.clear();
+                for (size_t i = 0; i < x["sensors"].size(); ++i)
+                    relayed_sensor_types[x["sensors"][i]["id"].to_string()] = x["sensors"][i]["type"].to_string();
+            }
+            else if (type == "removed_sensor")
+                relayed_sensor_types.erase(x["sensor"].to_string());
+            else
+                relayed_sensor_types[x["sensor"]["id"].to_string()] = x["sensor"]["type"].to_string();
+            invalidate(sensors_cache);
+            broadcast(std::move(msg));
+        }
+        else if (type == "new_sensor_value" || type == "new_sensor_state")
+        {
+            invalidate(sensors_cache);
+            const auto sensor = x["sensor"].to_string();
+            std::vector<std::string> topics{"sensor:" + sensor};
+            if (auto st_it = relayed_sensor_types.find(sensor); st_it != relayed_sensor_types.end())
+                topics.push_back("sensor_type:" + st_it->second);
+            broadcast(std::move(msg), true, type + ':' + sensor, std::move(topics));
+        }
+        else if (type == "solvers")
+        { // the solvers the primary no longer has are gone..
+            std::unordered_set<std::string> ids;
+            for (size_t i = 0; i < x["solvers"].size(); ++i)
+            {
+                auto id = x["solvers"][i]["id"].to_string();
+                relayed_solvers[id].info = std::move(x["solvers"][i]);
+                ids.insert(std::move(id));
+            }
+            for (auto it = relayed_solvers.begin(); it != relayed_solvers.end();)
+                if (!ids.count(it->first))
+                {
+                    forget_relayed_solver(it->second);
+                    it = relayed_solvers.erase(it);
+                }
+                else
+                    ++it;
+            broadcast(std::move(msg));
+        }
+        else if (type == "solver_created")
+        {
+            relayed_solvers[x["solver_id"].to_string()].info = json::json{{"id", x["solver_id"]}, {"name", x["name"]}, {"state", x["state"]}};
+            broadcast(std::move(msg));
+        }
+        else if (type == "solver_destroyed")
+        {
+            if (auto it = relayed_solvers.find(x["solver_id"].to_string()); it != relayed_solvers.end())
+            {
+                forget_relayed_solver(it->second);
+                relayed_solvers.erase(it);
+            }
+            broadcast(std::move(msg));
+        }
+        else if (type == "graph")
+        { // the relay versions the graph on its own, so its clients are brought up to date by the relay..
+            const auto id = x["solver_id"].to_string();
+            auto &slv = relayed_solvers[id];
+            forget_relayed_solver(slv);
+            slv.epoch = static_cast<long>(x["epoch"]);
+            slv.version = static_cast<long>(x["version"]);
+            json::json solver_id = x["solver_id"];
+            slv.graph = std::make_unique<graph_model>(solver_id, std::move(x));
+            broadcast(slv.graph->snapshot(), true, {}, {"solver:" + id});
+        }
+        else if (type == "batch" || x.has("version"))
+        { // the solver events, batched or not, keep the batches of the primary..
+            auto it = relayed_solvers.find(x["solver_id"].to_string());
+            if (it == relayed_solvers.end() || !it->second.graph)
+                return; // the graph will come with the next snapshot..
+            if (type == "batch")
+                for (size_t i = 0; i < x["messages"].size(); ++i)
+                    relay_event(it->second, x["messages"][i]);
+            else
+                relay_event(it->second, x);
+            flush_batch(it->second.graph.get());
+        }
+        else if (x.has("solver_id"))
+        { // the execution updates..
+            const auto id = x["solver_id"].to_string();
+            std::string key;
+            if (auto it = relayed_solvers.find(id); it != relayed_solvers.end())
+            {
+                auto &slv = it->second;
+                if (type == "state_changed")
+                {
+                    key = type + ':' + id;
+                    slv.state = std::move(x);
+                }
+                else if (type == "executor_state_changed" && x.has("state"))
+                    slv.info["state"] = x["state"];
+                else if (slv.state && type == "tick")
+                {
+                    key = type + ':' + id;
+                    (*slv.state)["time"] = x["time"];
+                }
+                else if (slv.state && (type == "start" || type == "end"))
+                { // the snapshot of the relay lists the atoms being executed..
+                    std::unordered_set<std::string> executing;
+                    if (slv.state->has("executing"))
+                        for (size_t i = 0; i < (*slv.state)["executing"].size(); ++i)
+                            executing.insert((*slv.state)["executing"][i].to_string());
+                    for (auto &atm : atoms_of(x))
+                        if (type == "start")
+                            executing.insert(std::move(atm));
+                        else
+                            executing.erase(atm);
+                    json::json j_executing(json::json_type::array);
+                    for (const auto &atm : executing)
+                        j_executing.push_back(json::load(atm));
+                    (*slv.state)["executing"] = std::move(j_executing);
+                }
+            }
+            broadcast(std::move(msg), true, std::move(key), {"solver:" + id});
+        }
+        else
+            broadcast(std::move(msg));
+    }
+
+    void coco_gui::relay_event(relayed_solver &slv, json::json &msg)
+    {
+        const auto version = static_cast<long>(msg["version"]);
+        if (version <= slv.version)
+            return; // already included in the graph..
+        slv.version = version;
+        const std::string kind = msg["type"];
+        batch(slv.graph.get(), slv.graph->get_solver_id(), slv.graph->apply(msg), kind);
+    }
+
+    void coco_gui::forget_relayed_solver(relayed_solver &slv)
+    {
+        if (!slv.graph)
+            return;
+        flush_batch(slv.graph.get());
+        std::lock_guard<std::mutex> _(batches_mtx);
+        batches.erase(slv.graph.get());
+    }
+
+    void coco_gui::relay_login(network::websocket_session &ws, json::json &x)
+    {
+        std::string token = x["token"];
+        std::shared_ptr<const principal> p;
+        try
+        { // the primary checks the token, along with the root of its user..
+            p = get_principal(token);
+        }
+        catch (const upstream_error &e)
+        { // the client retries once the primary is back..
+            LOG_WARN("Cannot check the token of a client: " << e.what());
+            ws.close(boost::beast::websocket::close_code::try_again_later);
+            return;
+        }
+        if (!p)
+        {
+            ws.send(json::json{{"type", "login"}, {"success", false}}.to_string());
+            return;
+        }
+        if (!p->member)
+        { // as the primary does, for the users of other roots..
+            ws.close(boost::beast::websocket::close_code::bad_payload);
+            return;
+        }
+
+        const auto format = x.has("format") && x["format"] == "msgpack" ? wire_format::msgpack : wire_format::json;
+        const bool compress = x.has("compress") && static_cast<bool>(x["compress"]);
+        try
+        {
+            with_snapshot({json::json{{"type", "login"}, {"success", true}, {"user", p->user}}.to_string()}, p->admin, parse_versions(x), metrics.lock_sites.get("relay_login"), [this, &ws, &p, format, compress](std::vector<std::string> &&frames)
+                          {
+                              ws_to_user[&ws] = p->id;
+                              user_to_ws[p->id] = &ws;
+                              auto s = add_session(ws, p->id, p->admin, format, compress);
+                              sync(s, std::move(frames));
+                              broadcast(json::json{{"type", "user_connected"}, {"user", p->id}}.to_string(), false); });
+        }
+        catch (const upstream_error &e)
+        { // the client retries once the primary is back..
+            LOG_WARN("Cannot send the snapshot to a client: " << e.what());
+            ws.close(boost::beast::websocket::close_code::try_again_later);
+        }
+    }
+
+    coco_gui::relayed_lists coco_gui::fetch_relayed_lists(bool admin)
+    {
+        relayed_lists lists;
+        lists.sensor_types = get_cached(sensor_types_cache, [this]()
+                                        { return sensor_types_message(); });
+        lists.sensors = sensors_response();
+        if (admin)
+            lists.users = get_cached(users_cache, [this]()
+                                     { return users_message(); });
+        return lists;
+    }
+
+    void coco_gui::relayed_snapshot(std::vector<std::string> &frames, const relayed_lists &lists, const std::unordered_map<std::string, std::pair<long, long>> &versions)
+    {
+        frames.push_back(lists.sensor_types->body);
+        frames.push_back(lists.sensors->body);
+
+        json::json j_solvers{{"type", "solvers"}};
+        json::json c_solvers(json::json_type::array);
+        for (const auto &[id, slv] : relayed_solvers)
+            c_solvers.push_back(slv.info);
+        j_solvers["solvers"] = std::move(c_solvers);
+        frames.push_back(j_solvers.to_string());
+
+        for (auto &[id, slv] : relayed_solvers)
+            relayed_solver_snapshot(frames, slv, versions);
+
+        if (lists.users)
+            frames.push_back(lists.users->body);
+    }
+
+    void coco_gui::relayed_solver_snapshot(std::vector<std::string> &frames, relayed_solver &slv, const std::unordered_map<std::string, std::pair<long, long>> &versions)
+    {
+        if (slv.state)
+            frames.push_back(slv.state->to_string());
+        if (slv.graph)
+            graph_snapshot(frames, *slv.graph, versions);
+    }
+
+    json::json coco_gui::upstream_list(const std::string &target)
+    {
+        auto r = upstream_get(upstream->host, upstream->port, target, upstream->token);
+        if (r.status != 200)
+            throw upstream_error("The primary server answered " + target + " with " + std::to_string(r.status));
+        return json::load(r.body);
+    }
+
+    void coco_gui::broadcast(std::string &&msg, bool to_all, std::string &&key, std::vector<std::string> &&topics)
+    {
+        if (auto r = std::atomic_load(&recorder))
+            r->write(event_kind::broadcast, msg, to_all, key, topics);
+        enqueue(std::move(msg), to_all, std::move(key), std::move(topics));
+    }
+
+    void coco_gui::enqueue(std::string &&msg, bool to_all, std::string &&key, std::vector<std::string> &&topics)
+    {
+        const auto size = msg.size();
+        metrics.broadcasts.inc();
+        metrics.broadcast_bytes.inc(size);
+        if (encoded_sessions) // the message will be encoded by the fan-out thread, which builds the plain frame too, if needed..
+            out_queue.push({{}, size, to_all, std::move(key), std::move(topics), std::make_shared<std::string>(std::move(msg))});
+        else
+            out_queue.push({new network::message(std::move(msg)), size, to_all, std::move(key), std::move(topics)});
+        wake_fanout();
+    }
+
+    graph_model &coco_gui::get_graph(const coco_executor &exec)
+    {
+        auto it = graphs.find(&exec);
+        if (it == graphs.end()) // we take the whole graph only once, it is kept up to date by the solver events..
+            it = graphs.emplace(&exec, std::make_unique<graph_model>(get_id(exec.get_executor().get_solver()), to_graph(exec))).first;
+        return *it->second;
+    }
+
+    void coco_gui::batch(const coco_executor &exec, json::json &&msg, const std::string_view &kind, const void *item)
+    {
+        auto &gm = get_graph(exec);
+        batch(&exec, gm.get_solver_id(), gm.apply(msg), kind, item);
+    }
+
+    void coco_gui::batch(const void *solver, const std::string &solver_id, std::string &&s_msg, const std::string_view &kind, const void *item)
+    {
+        if (auto r = std::atomic_load(&recorder))
+            r->write(event_kind::solver_event, s_msg, true, std::string(kind), {}, solver_id, reinterpret_cast<std::uintptr_t>(item));
+        if (!batch_window)
+        {
+            enqueue(std::move(s_msg), true, {}, {"solver:" + solver_id});
+            return;
+        }
+
+        std::lock_guard<std::mutex> _(batches_mtx);
+        auto &b = batches[solver];
+        if (b.messages.empty())
+        {
+            b.solver_id = solver_id;
+            b.opened = std::chrono::steady_clock::now();
+        }
+
+        if (item)
+        {
+            auto [it, inserted] = b.latest.emplace(std::make_pair(kind, item), b.messages.size());
+            if (!inserted)
+            { // only the latest update of an item, within the same window, survives..
+                b.messages[it->second] = std::move(s_msg);
+                return;
+            }
+        }
+        b.messages.push_back(std::move(s_msg));
+
+        if (b.messages.size() >= batch_size)
+            send_batch(b);
+        else if (!batches_pending.exchange(true))
+            wake_fanout(); // the fan-out thread has to start timing the window..
+    }
+
+    void coco_gui::flush_batch(const void *solver)
+    {
+        std::lock_guard<std::mutex> _(batches_mtx);
+        if (auto it = batches.find(solver); it != batches.end() && !it->second.messages.empty())
+        {
+            if (auto r = std::atomic_load(&recorder)) // the replay has to flush the batch before the following messages..
+                r->write(event_kind::flush, {}, true, {}, {}, it->second.solver_id);
+            send_batch(it->second);
+        }
+    }
+
+    void coco_gui::flush_batches(bool all)
+    {
+        std::lock_guard<std::mutex> _(batches_mtx);
+        const auto due = std::chrono::steady_clock::now() - std::chrono::milliseconds(batch_window.load());
+        bool pending = false;
+        for (auto &[exec, b] : batches)
+            if (!b.messages.empty())
+            {
+                if (all || b.opened <= due)
+                    send_batch(b);
+                else
+                    pending = true;
+            }
+        batches_pending = pending;
+    }
+
+    void coco_gui::send_batch(solver_batch &b)
+    {
+        if (b.messages.size() == 1)
+            enqueue(std::move(b.messages.front()), true, {}, {"solver:" + b.solver_id});
         else
-            for (auto &[tkn, conn] : user_to_ws)
-                if (cc.get_database().get_user(tkn).get_data()["type"] == "admin")
-                    conn->send(m);
+        { // the messages are already serialized, so we just join them..
+            std::size_t capacity = 64 + b.solver_id.size();
+            for (const auto &m : b.messages)
+                capacity += m.size() + 1;
+            json_writer w(capacity);
+            w.begin_object().key("type").value("batch").key("solver_id").raw(b.solver_id).key("messages").begin_array();
+            for (const auto &m : b.messages)
+                w.raw(m);
+            w.end_array().end_object();
+            enqueue(w.release(), true, {}, {"solver:" + b.solver_id});
+        }
+        b.messages.clear();
+        b.latest.clear();
+    }
+
+    void coco_gui::sync(const std::shared_ptr<gui_session> &s, std::vector<std::string> &&frames) { sync(std::make_shared<session_sync>(session_sync{s, std::move(frames)})); }
+
+    void coco_gui::sync(std::shared_ptr<session_sync> &&y)
+    {
+        outgoing_message m{};
+        m.sync = std::move(y);
+        out_queue.push(std::move(m));
+        wake_fanout();
+    }
+
+    void coco_gui::synchronize(session_sync &y)
+    {
+        auto &s = *y.session;
+        const auto c_sessions = std::atomic_load(&sessions);
+        if (auto it = c_sessions->find(&s.ws); it == c_sessions->end() || it->second != y.session)
+            return; // the session is gone (its removal waits for the fan-out thread, so its socket is still there otherwise)..
+        if (y.subscription)
+        { // the session changes its subscriptions here, the following messages being filtered accordingly..
+            {
+                std::lock_guard<std::mutex> _(sessions_mtx);
+                if (y.unfiltered)
+                    s.topics.clear();
+                for (const auto &t : y.unsubscribed)
+                    s.topics.erase(t);
+                s.topics.insert(y.subscribed.begin(), y.subscribed.end());
+                s.filtered = !y.unfiltered;
+                std::atomic_store(&subscriptions, index_subscriptions(*std::atomic_load(&sessions)));
+            }
+            {
+                std::lock_guard<std::mutex> _(s.mtx);
+                if (s.stale)
+                    return; // the session gets the whole state with its fresh snapshot..
+            }
+        }
+        for (const auto &f : y.frames)
+            send(s, f);
+        if (y.subscription)
+            return;
+        std::lock_guard<std::mutex> _(s.mtx);
+        s.stale = s.syncing = false;
+    }
+
+    void coco_gui::wake_fanout()
+    {
+        if (fanout_idle)
+        { // the fan-out thread is (or is about to be) waiting..
+            std::lock_guard<std::mutex> _(wake_mtx);
+            wake_cv.notify_one();
+        }
+    }
+
+    std::shared_ptr<coco_gui::gui_session> coco_gui::add_session(network::websocket_session &ws, const std::string &user_id, bool admin, wire_format format, bool compress, bool relay)
+    {
+        auto s = std::make_shared<gui_session>(++session_count, ws, user_id, admin, format, compress, relay);
+        s->stale = s->syncing = true; // the session receives the broadcast messages once it is synchronized..
+        std::lock_guard<std::mutex> _(sessions_mtx);
+        auto c_sessions = std::make_shared<session_registry>(*std::atomic_load(&sessions));
+        for (auto it = c_sessions->begin(); it != c_sessions->end();)
+            if (it->second->user_id == user_id && !relay && !it->second->relay) // a user receives the updates only on its most recent connection (but the relays, sharing their token)..
+            {
+                if (it->second->format == wire_format::msgpack || it->second->compress)
+                    encoded_sessions--;
+                it = c_sessions->erase(it);
+            }
+            else
+                ++it;
+        if (format == wire_format::msgpack || compress)
+            encoded_sessions++;
+        (*c_sessions)[&ws] = s;
+        std::atomic_store(&subscriptions, index_subscriptions(*c_sessions));
+        std::atomic_store(&sessions, std::shared_ptr<const session_registry>(std::move(c_sessions)));
+        return s;
+    }
+
+    void coco_gui::remove_session(network::websocket_session &ws)
+    {
+        {
+            std::lock_guard<std::mutex> _(sessions_mtx);
+            auto c_sessions = std::make_shared<session_registry>(*std::atomic_load(&sessions));
+            auto it = c_sessions->find(&ws);
+            if (it == c_sessions->end())
+                return;
+            if (it->second->format == wire_format::msgpack || it->second->compress)
+                encoded_sessions--;
+            c_sessions->erase(it);
+            std::atomic_store(&subscriptions, index_subscriptions(*c_sessions));
+            std::atomic_store(&sessions, std::shared_ptr<const session_registry>(std::move(c_sessions)));
+        }
+        // the fan-out thread might still be sending through the previous snapshot, or closing the session, so we wait for it to be done with it..
+        {
+            std::lock_guard<std::mutex> _(fanout_mtx);
+        }
+        std::lock_guard<std::recursive_mutex> _(close_mtx);
+    }
+
+    /**
+     * @brief Creates a WebSocket message with the binary opcode.
+     */
+    static network::message *binary_message(std::string &&payload) { return new network::message(std::move(payload), 0x82); }
+
+    /**
+     * @brief Compresses the given payload into a raw deflate stream, prefixed by the 0xC1 byte (which is never used by MessagePack) to mark the frame as compressed.
+     *
+     * Each message is compressed on its own, without context takeover, so that the compressed frame can be shared by all the sessions.
+     *
+     * @return the compressed payload, or nothing if the compression failed (the payload being then sent as it is).
+     */
+    static std::optional<std::string> compress(const std::string &payload)
+    {
+        thread_local boost::beast::zlib::deflate_stream ds; // the compression state is reused, saving the allocation of its window..
+        ds.reset(6, 15, 8, boost::beast::zlib::Strategy::normal);
+
+        std::string out(1 + ds.upper_bound(payload.size()), '\0');
+        out[0] = static_cast<char>(0xC1);
+        boost::beast::zlib::z_params zs;
+        zs.next_in = payload.data();
+        zs.avail_in = payload.size();
+        zs.next_out = &out[1];
+        zs.avail_out = out.size() - 1;
+        boost::system::error_code ec;
+        ds.write(zs, boost::beast::zlib::Flush::finish, ec);
+        if (ec != boost::beast::zlib::error::end_of_stream) // the stream is complete only once the whole payload is consumed..
+        {
+            LOG_WARN("Cannot compress a message: " << ec.message());
+            return std::nullopt;
+        }
+        out.resize(1 + zs.total_out);
+        return out;
+    }
+
+    void coco_gui::send(gui_session &s, const std::string &msg)
+    {
+        if (s.format == wire_format::msgpack || (s.compress && msg.size() >= compression_threshold))
+        { // messages to a single session are encoded on the spot..
+            std::string payload;
+            if (s.format == wire_format::msgpack)
+                payload = to_msgpack(msg);
+            if (s.compress && msg.size() >= compression_threshold)
+            {
+                if (auto z_msg = compress(s.format == wire_format::msgpack ? payload : msg))
+                    payload = std::move(*z_msg);
+                else if (s.format != wire_format::msgpack)
+                {
+                    std::lock_guard<std::mutex> _(s.mtx);
+                    send(s, new network::message(msg), msg.size());
+                    return;
+                }
+            }
+            const auto size = payload.size();
+            std::lock_guard<std::mutex> _(s.mtx);
+            send(s, binary_message(std::move(payload)), size);
+            return;
+        }
+        std::lock_guard<std::mutex> _(s.mtx);
+        send(s, new network::message(msg), msg.size());
+    }
+
+    void coco_gui::send(gui_session &s, const utils::c_ptr<network::message> &msg, std::size_t size)
+    {
+        s.in_flight.push_back(size);
+        s.in_flight_bytes += size;
+        s.ws.send(msg);
+    }
+
+    const coco_gui::frame *coco_gui::select(const gui_session &s, const outgoing_message &m) const
+    {
+        const auto &z = s.format == wire_format::msgpack ? m.z_bin : m.z_text;
+        if (s.compress && m.size >= compression_threshold && z)
+            return &*z;
+        if (s.format == wire_format::msgpack && m.bin)
+            return &*m.bin;
+        return nullptr; // the message was broadcast before the session asked for another encoding..
+    }
+
+    void coco_gui::send(gui_session &s, const outgoing_message &m)
+    {
+        if (auto f = select(s, m))
+            send(s, f->msg, f->size);
+        else
+            send(s, m.msg, m.size);
+    }
+
+    void coco_gui::encode(outgoing_message &m, const std::vector<const std::shared_ptr<gui_session> *> &targets)
+    {
+        bool plain = false, bin = false, z_text = false, z_bin = false;
+        const bool compressible = m.size >= compression_threshold;
+        for (const auto s : targets)
+        {
+            const bool msgpack = (*s)->format == wire_format::msgpack, compressed = (*s)->compress && compressible;
+            plain |= !msgpack && !compressed;
+            bin |= msgpack && !compressed;
+            z_text |= !msgpack && compressed;
+            z_bin |= msgpack && compressed;
+        }
+
+        if (bin || z_bin)
+        {
+            std::string b_msg = to_msgpack(*m.text);
+            if (z_bin)
+            {
+                if (auto z_msg = compress(b_msg))
+                {
+                    const auto size = z_msg->size();
+                    m.z_bin = frame{binary_message(std::move(*z_msg)), size};
+                }
+                else
+                    bin = true; // the sessions get the uncompressed frame..
+            }
+            if (bin)
+            {
+                const auto size = b_msg.size();
+                m.bin = frame{binary_message(std::move(b_msg)), size};
+            }
+        }
+        if (z_text)
+        {
+            if (auto z_msg = compress(*m.text))
+            {
+                const auto size = z_msg->size();
+                m.z_text = frame{binary_message(std::move(*z_msg)), size};
+            }
+            else
+                plain = true; // the sessions get the uncompressed frame..
+        }
+        if (plain)
+            m.msg = new network::message(std::move(*m.text));
+        m.text.reset(); // every encoding is built, the text is not needed anymore..
+    }
+
+    bool coco_gui::deliver(gui_session &s, const outgoing_message &m)
+    {
+        std::lock_guard<std::mutex> _(s.mtx);
+        if (s.stale || s.closing)
+            return false; // the session will be (re)synchronized (or it is being closed)..
+
+        const auto hwm = high_water_mark.load();
+        if (s.in_flight.size() < hwm)
+        {
+            send(s, m);
+            return false;
+        }
+
+        auto policy = slow_consumer.load();
+        if (s.relay && policy == slow_consumer_policy::disconnect)
+            policy = slow_consumer_policy::resync; // disconnecting a relay would disconnect all of its clients..
+        switch (policy) // the session is over its high-water mark..
+        {
+        case slow_consumer_policy::drop:
+            if (!m.key.empty())
+            { // we keep only the latest message for each key, until the client catches up..
+                auto [it, inserted] = s.held_index.emplace(m.key, s.held.size());
+                if (inserted)
+                    s.held.push_back(m);
+                else
+                    s.held[it->second] = m;
+                return false;
+            }
+            if (s.in_flight.size() < 2 * hwm)
+            { // structural messages can't be dropped without the client diverging, and must not be overtaken by the held ones..
+                for (const auto &h : s.held)
+                    send(s, h);
+                s.held.clear();
+                s.held_index.clear();
+                send(s, m);
+                return false;
+            }
+            [[fallthrough]];
+        case slow_consumer_policy::resync:
+            LOG_WARN("Session " << s.id << " is too slow, it will be resynchronized..");
+            s.stale = true;
+            s.held.clear();
+            s.held_index.clear();
+            return false;
+        case slow_consumer_policy::disconnect:
+            LOG_WARN("Session " << s.id << " is too slow, closing it..");
+            s.closing = true;
+            return true;
+        }
+        return false;
+    }
+
+    void coco_gui::acknowledge(network::websocket_session &ws, std::size_t received)
+    {
+        const auto c_sessions = std::atomic_load(&sessions);
+        auto it = c_sessions->find(&ws);
+        if (it == c_sessions->end())
+            return;
+        auto s = it->second;
+
+        {
+            std::lock_guard<std::mutex> _(s->mtx);
+            while (s->acked < received && !s->in_flight.empty())
+            {
+                s->in_flight_bytes -= s->in_flight.front();
+                s->in_flight.pop_front();
+                s->acked++;
+            }
+
+            if (!s->stale)
+            { // we send the held messages, if the client has room for them..
+                if (!s->held.empty() && s->in_flight.size() < high_water_mark)
+                {
+                    for (const auto &m : s->held)
+                        send(*s, m);
+                    s->held.clear();
+                    s->held_index.clear();
+                }
+                return;
+            }
+            if (!s->in_flight.empty() || s->syncing)
+                return; // we wait for the client to drain its queue before resynchronizing it (unless the snapshot is already queued)..
+            s->syncing = true;
+        }
+
+        LOG_DEBUG("Resynchronizing session " << s->id << "..");
+        try
+        {
+            with_snapshot({}, s->admin, {}, acknowledge_site, [this, &s](std::vector<std::string> &&frames)
+                          { sync(s, std::move(frames)); }); // the session receives the broadcast messages again from the point of the snapshot..
+        }
+        catch (const upstream_error &e)
+        { // the client reconnects once the primary is back..
+            LOG_WARN("Cannot resynchronize session " << s->id << ": " << e.what());
+            s->ws.close(boost::beast::websocket::close_code::try_again_later);
+        }
+    }
+
+    json::json coco_gui::sessions_message()
+    {
+        json::json j_sessions{{"type", "sessions"}};
+        json::json c_sessions(json::json_type::array);
+        for (const auto &[ws, s] : *std::atomic_load(&sessions))
+        {
+            std::lock_guard<std::mutex> _(s->mtx);
+            c_sessions.push_back({{"session", static_cast<long>(s->id)}, {"admin", s->admin}, {"queued", static_cast<long>(s->in_flight.size())}, {"queued_bytes", static_cast<long>(s->in_flight_bytes)}, {"held", static_cast<long>(s->held.size())}, {"stale", s->stale}, {"relay", s->relay}});
+        }
+        j_sessions["sessions"] = std::move(c_sessions);
+        return j_sessions;
+    }
+
+    void coco_gui::fanout()
+    {
+        while (running)
+        {
+            bool batches_due = false;
+            {
+                std::unique_lock<std::mutex> lock(wake_mtx);
+                fanout_idle = true;
+                if (batches_pending || executions_pending)
+                { // we wait, at most, for the shortest of the pending windows..
+                    auto timeout = std::chrono::milliseconds::max();
+                    if (batches_pending)
+                        timeout = std::chrono::milliseconds(batch_window.load());
+                    if (const auto rate = execution_rate.load(); executions_pending)
+                        timeout = std::min(timeout, std::chrono::milliseconds(rate > 0 ? static_cast<long>(std::ceil(1000 / rate)) : 0));
+                    const bool timed_out = !wake_cv.wait_for(lock, timeout, [this]
+                                                             { return !out_queue.empty() || !running; });
+                    batches_due = timed_out && timeout.count() == batch_window.load();
+                }
+                else
+                    wake_cv.wait(lock, [this]
+                                 { return !out_queue.empty() || !running || batches_pending || executions_pending; });
+                fanout_idle = false;
+            }
+            if (batches_pending)
+                flush_batches(batches_due);
+            if (executions_pending)
+                flush_executions();
+
+            std::vector<std::shared_ptr<gui_session>> to_close;
+            {
+                std::lock_guard<std::mutex> _(fanout_mtx);
+                auto c_sessions = std::atomic_load(&sessions);
+                auto c_subscriptions = std::atomic_load(&subscriptions);
+                while (auto m = out_queue.pop())
+                {
+                    if (m->sync)
+                    { // a session joins the stream here, the following messages being delivered to it..
+                        synchronize(*m->sync);
+                        c_sessions = std::atomic_load(&sessions);
+                        c_subscriptions = std::atomic_load(&subscriptions);
+                        continue;
+                    }
+                    const auto start = std::chrono::steady_clock::now();
+                    ++sequence;
+                    fanout_targets.clear();
+                    const auto to = [this, &m](const std::shared_ptr<gui_session> &s)
+                    {
+                        if ((!m->to_all && !s->admin) || s->last_delivered == sequence)
+                            return; // the session is not allowed to receive the message, or it has already received it through another topic..
+                        s->last_delivered = sequence;
+                        fanout_targets.push_back(&s);
+                    };
+                    if (m->topics.empty())
+                        for (const auto &[ws, s] : *c_sessions)
+                            to(s);
+                    else
+                    { // only the sessions interested in the topics of the message receive it..
+                        for (const auto &s : c_subscriptions->unfiltered)
+                            to(s);
+                        for (const auto &t : m->topics)
+                            if (auto it = c_subscriptions->subscribers.find(t); it != c_subscriptions->subscribers.end())
+                                for (const auto &s : it->second)
+                                    to(s);
+                    }
+                    if (m->text) // the message is encoded once, for all the sessions which need the same encoding..
+                        encode(*m, fanout_targets);
+                    for (const auto s : fanout_targets)
+                        if (deliver(**s, *m))
+                            to_close.push_back(*s);
+                    metrics.fanout.observe(std::chrono::steady_clock::now() - start);
+                }
+            }
+            // closing a session might call back into `on_ws_error`, which waits for the fan-out thread, hence we close them out of the fan-out lock, holding instead the one their removal waits for (so that the socket of a session still in the registry outlives the call)..
+            if (!to_close.empty())
+            {
+                std::lock_guard<std::recursive_mutex> _(close_mtx);
+                const auto c_sessions = std::atomic_load(&sessions);
+                for (const auto &s : to_close)
+                    if (auto it = c_sessions->find(&s->ws); it != c_sessions->end() && it->second == s)
+                        s->ws.close(boost::beast::websocket::close_code::policy_error);
+            }
+        }
     }
 } // namespace coco_gui
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "event_log.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace coco::coco_gui
+{
+    static constexpr char magic[] = {'C', 'C', 'E', 'V', '1', '\n'};
+    static constexpr std::size_t buffer_size = 1 << 16; // the size of the buffered records written at once..
+
+    static void write_varint(std::string &buf, std::uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            buf += static_cast<char>((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        buf += static_cast<char>(v);
+    }
+    static void write_string(std::string &buf, const std::string &s)
+    {
+        write_varint(buf, s.size());
+        buf += s;
+    }
+
+    event_log_writer::event_log_writer(const std::string &path) : out(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!out)
+            throw std::runtime_error("Cannot open the event log " + path);
+        out.write(magic, sizeof(magic));
+        buf.reserve(buffer_size);
+        writer = std::thread(&event_log_writer::run, this);
+    }
+    event_log_writer::~event_log_writer()
+    {
+        {
+            std::lock_guard<std::mutex> _(mtx);
+            stopping = true;
+        }
+        wake_cv.notify_one();
+        writer.join();
+    }
+
+    void event_log_writer::write(event_kind kind, const std::string &payload, bool to_all, const std::string &key, const std::vector<std::string> &topics, const std::string &solver_id, std::uint64_t item)
+    {
+        const auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::lock_guard<std::mutex> _(mtx);
+        // the times are stored as deltas from the previous record, most of them fitting in a couple of bytes..
+        write_varint(buf, time > last ? (time - last).count() : 0);
+        last = std::max(time, last);
+        buf += static_cast<char>(kind);
+        buf += static_cast<char>(to_all);
+        write_string(buf, solver_id);
+        write_string(buf, key);
+        write_varint(buf, item);
+        write_varint(buf, topics.size());
+        for (const auto &t : topics)
+            write_string(buf, t);
+        write_string(buf, payload);
+        if (buf.size() >= buffer_size)
+            wake_cv.notify_one();
+    }
+
+    void event_log_writer::flush()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        const auto requested = ++flushes_requested;
+        wake_cv.notify_one();
+        flushed_cv.wait(lock, [this, requested]
+                        { return flushes_done >= requested; });
+    }
+
+    void event_log_writer::run()
+    {
+        std::string chunk; // the buffer being written, swapped with the one being filled..
+        chunk.reserve(buffer_size);
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true)
+        { // the server usually runs until it is killed, so we write at least once a second..
+            wake_cv.wait_for(lock, std::chrono::seconds(1), [this]
+                             { return buf.size() >= buffer_size || flushes_requested > flushes_done || stopping; });
+            const auto requested = flushes_requested;
+            const bool stop = stopping;
+            chunk.swap(buf);
+            lock.unlock();
+            if (!chunk.empty())
+            {
+                out.write(chunk.data(), chunk.size());
+                out.flush();
+                chunk.clear();
+            }
+            lock.lock();
+            if (flushes_done < requested)
+            {
+                flushes_done = requested;
+                flushed_cv.notify_all();
+            }
+            if (stop)
+                return;
+        }
+    }
+
+    event_log_reader::event_log_reader(const std::string &path) : in(path, std::ios::binary)
+    {
+        char header[sizeof(magic)];
+        if (!in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), magic))
+            throw std::runtime_error("Not an event log " + path);
+    }
+
+    bool event_log_reader::next(event_record &r)
+    {
+        std::uint64_t delta, item, n_topics;
+        if (!read_varint(delta))
+            return false;
+        last += std::chrono::microseconds(delta);
+        r.time = last;
+        const int kind = in.get(), to_all = in.get();
+        if (to_all == std::char_traits<char>::eof() || kind > static_cast<int>(event_kind::flush))
+            return false;
+        r.kind = static_cast<event_kind>(kind);
+        r.to_all = to_all;
+        if (!read_string(r.solver_id) || !read_string(r.key) || !read_varint(item) || !read_varint(n_topics))
+            return false;
+        r.item = item;
+        r.topics.resize(n_topics);
+        for (auto &t : r.topics)
+            if (!read_string(t))
+                return false;
+        return read_string(r.payload);
+    }
+
+    bool event_log_reader::read_varint(std::uint64_t &v)
+    {
+        v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            const int c = in.get();
+            if (c == std::char_traits<char>::eof())
+                return false;
+            v |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool event_log_reader::read_string(std::string &s)
+    {
+        std::uint64_t size;
+        if (!read_varint(size) || size > (std::uint64_t(1) << 30)) // a larger size means the log is corrupted..
+            return false;
+        s.resize(size);
+        return size == 0 || static_cast<bool>(in.read(s.data(), size));
+    }
+} // namespace coco::coco_gui
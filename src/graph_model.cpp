@@ -0,0 +1,131 @@
+#include "graph_model.h"
+#include <chrono>
+
+namespace coco::coco_gui
+{
+    graph_model::graph_model(const json::json &solver_id, json::json graph, const std::size_t max_deltas) : solver_id(solver_id), s_solver_id(solver_id.to_string()), epoch(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()), extra(json::json_type::object), max_deltas(max_deltas)
+    {
+        for (auto &[key, value] : graph.get_object())
+            if (key == "flaws")
+                for (size_t i = 0; i < value.size(); ++i)
+                    add(flaws, flaws_index, value[i]);
+            else if (key == "resolvers")
+                for (size_t i = 0; i < value.size(); ++i)
+                    add(resolvers, resolvers_index, value[i]);
+            else if (key != "type" && key != "solver_id")
+                extra[key] = value;
+    }
+
+    long graph_model::get_version()
+    {
+        std::lock_guard<std::mutex> _(mtx);
+        return version;
+    }
+
+    std::string graph_model::apply(json::json &msg)
+    {
+        std::lock_guard<std::mutex> _(mtx);
+        std::string type = msg["type"];
+        if (type == "flaw_created")
+            add(flaws, flaws_index, msg);
+        else if (type == "flaw_state_changed" || type == "flaw_cost_changed" || type == "flaw_position_changed")
+            update(flaws, flaws_index, msg);
+        else if (type == "resolver_created")
+            add(resolvers, resolvers_index, msg);
+        else if (type == "resolver_state_changed")
+            update(resolvers, resolvers_index, msg);
+        else if (type == "current_flaw" || type == "current_resolver")
+            extra[type] = msg["id"];
+        else if (type == "causal_link_added")
+        {
+            auto r_it = resolvers_index.find(msg["resolver_id"].to_string());
+            if (r_it != resolvers_index.end())
+            {
+                auto &r = resolvers[r_it->second];
+                if (!r.has("preconditions"))
+                    r["preconditions"] = json::json(json::json_type::array);
+                r["preconditions"].push_back(msg["flaw_id"]);
+            }
+        }
+
+        msg["version"] = ++version;
+        std::string s_msg = msg.to_string();
+        log.emplace_back(version, s_msg);
+        while (log.size() > max_deltas)
+            log.pop_front();
+        return s_msg;
+    }
+
+    std::string graph_model::snapshot()
+    {
+        std::lock_guard<std::mutex> _(mtx);
+        if (c_snapshot_version != version)
+        { // we serialize the graph only once per version..
+            json::json j_gr = extra;
+            j_gr["type"] = "graph";
+            j_gr["solver_id"] = solver_id;
+            j_gr["epoch"] = epoch;
+            j_gr["version"] = version;
+            json::json j_flaws(json::json_type::array);
+            for (const auto &f : flaws)
+                j_flaws.push_back(f);
+            j_gr["flaws"] = std::move(j_flaws);
+            json::json j_resolvers(json::json_type::array);
+            for (const auto &r : resolvers)
+                j_resolvers.push_back(r);
+            j_gr["resolvers"] = std::move(j_resolvers);
+            c_snapshot = j_gr.to_string();
+            c_snapshot_version = version;
+        }
+        return c_snapshot;
+    }
+
+    std::optional<std::string> graph_model::deltas(const long epoch, const long version)
+    {
+        std::lock_guard<std::mutex> _(mtx);
+        if (epoch != this->epoch || version > this->version)
+            return std::nullopt; // the client knows a different graph..
+        if (version == this->version)
+            return std::string(); // the client is already up to date..
+        if (log.empty() || log.front().first > version + 1)
+            return std::nullopt; // some of the events are no longer available..
+
+        // the events are already serialized, so we just join them..
+        std::size_t capacity = 128 + s_solver_id.size();
+        for (auto it = log.rbegin(); it != log.rend() && it->first > version; ++it)
+            capacity += it->second.size() + 1;
+        json_writer w(capacity);
+        w.begin_object().key("type").value("batch").key("solver_id").raw(s_solver_id).key("epoch").value(this->epoch).key("version").value(this->version).key("messages").begin_array();
+        for (const auto &[v, msg] : log)
+            if (v > version)
+                w.raw(msg);
+        w.end_array().end_object();
+        return w.release();
+    }
+
+    void graph_model::add(std::vector<json::json> &items, std::unordered_map<std::string, std::size_t> &index, json::json &msg)
+    {
+        auto [it, inserted] = index.emplace(msg["id"].to_string(), items.size());
+        if (inserted)
+        {
+            json::json item(json::json_type::object);
+            merge(item, msg);
+            items.push_back(std::move(item));
+        }
+        else // the item is already known (e.g., the graph was taken after its creation)..
+            merge(items[it->second], msg);
+    }
+
+    void graph_model::update(std::vector<json::json> &items, std::unordered_map<std::string, std::size_t> &index, json::json &msg)
+    {
+        if (auto it = index.find(msg["id"].to_string()); it != index.end())
+            merge(items[it->second], msg);
+    }
+
+    void graph_model::merge(json::json &item, json::json &msg)
+    {
+        for (auto &[key, value] : msg.get_object())
+            if (key != "type" && key != "solver_id" && key != "version")
+                item[key] = value;
+    }
+} // namespace coco::coco_gui
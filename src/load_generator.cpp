@@ -0,0 +1,262 @@
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+
+struct options
+{
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string token;                    // the token the clients log in with, and publish with..
+    std::size_t clients = 100;            // the number of WebSocket clients..
+    std::vector<std::string> sensors;     // the sensors the values are published to..
+    std::string value = "{\"value\": 0}"; // the published value..
+    double rate = 0;                      // the published values per second (zero for no publishing)..
+    std::size_t publishers = 4;           // the number of HTTP connections publishing the values..
+    std::size_t duration = 30;            // the duration of the run, in seconds..
+    bool msgpack = false;
+    bool compress = false;
+};
+
+struct stats
+{
+    std::atomic<std::size_t> connected{0}, failed{0}, messages{0}, bytes{0}, published{0}, publish_errors{0};
+    std::atomic<std::uint64_t> publish_us{0}, publish_max_us{0};
+};
+
+/**
+ * @brief A WebSocket client which logs in, acknowledges the received messages, like the bundled client, and counts them.
+ */
+class client : public std::enable_shared_from_this<client>
+{
+public:
+    client(net::io_context &ioc, const options &opts, stats &st) : resolver(net::make_strand(ioc)), ws(net::make_strand(ioc)), opts(opts), st(st) {}
+
+    void start()
+    {
+        resolver.async_resolve(opts.host, opts.port, [self = shared_from_this()](beast::error_code ec, tcp::resolver::results_type results)
+                               {
+                                   if (ec)
+                                       return self->fail();
+                                   beast::get_lowest_layer(self->ws).async_connect(results, [self](beast::error_code ec, tcp::resolver::results_type::endpoint_type)
+                                                                                    {
+                                                                                        if (ec)
+                                                                                            return self->fail();
+                                                                                        self->ws.async_handshake(self->opts.host, "/coco", [self](beast::error_code ec)
+                                                                                                                 {
+                                                                                                                     if (ec)
+                                                                                                                         return self->fail();
+                                                                                                                     self->st.connected++;
+                                                                                                                     self->send("{\"type\":\"login\",\"token\":\"" + self->opts.token + "\",\"ack\":true" + (self->opts.msgpack ? ",\"format\":\"msgpack\"" : "") + (self->opts.compress ? ",\"compress\":true" : "") + "}");
+                                                                                                                     self->read();
+                                                                                                                 });
+                                                                                    });
+                               });
+    }
+
+private:
+    void read()
+    {
+        ws.async_read(buffer, [self = shared_from_this()](beast::error_code ec, std::size_t size)
+                      {
+                          if (ec)
+                          {
+                              self->st.connected--;
+                              return self->fail();
+                          }
+                          self->buffer.consume(size);
+                          self->st.messages++;
+                          self->st.bytes += size;
+                          if (++self->received % 64 == 0) // like the bundled client, we acknowledge every 64 messages..
+                              self->send("{\"type\":\"ack\",\"token\":\"" + self->opts.token + "\",\"received\":" + std::to_string(self->received) + "}");
+                          self->read();
+                      });
+    }
+
+    void send(std::string &&msg)
+    {
+        outbox.push_back(std::move(msg));
+        if (outbox.size() == 1)
+            write();
+    }
+
+    void write()
+    {
+        ws.text(true);
+        ws.async_write(net::buffer(outbox.front()), [self = shared_from_this()](beast::error_code ec, std::size_t)
+                       {
+                           if (ec)
+                               return;
+                           self->outbox.erase(self->outbox.begin());
+                           if (!self->outbox.empty())
+                               self->write();
+                       });
+    }
+
+    void fail() { st.failed++; }
+
+private:
+    tcp::resolver resolver;
+    websocket::stream<beast::tcp_stream> ws;
+    beast::flat_buffer buffer;
+    std::vector<std::string> outbox;
+    std::size_t received = 0;
+    const options &opts;
+    stats &st;
+};
+
+/**
+ * @brief Publishes the values, at the given rate, through a keep-alive HTTP connection.
+ */
+static void publish(const options &opts, stats &st, const double rate, const std::chrono::steady_clock::time_point end)
+{
+    net::io_context ioc;
+    tcp::resolver resolver(ioc);
+    beast::tcp_stream stream(ioc);
+    // the failures are counted, rather than thrown, since an exception escaping the thread would terminate the whole run..
+    beast::error_code ec;
+    const auto results = resolver.resolve(opts.host, opts.port, ec);
+    if (ec)
+    {
+        std::cerr << "Cannot resolve " << opts.host << ':' << opts.port << ": " << ec.message() << std::endl;
+        st.publish_errors++;
+        return;
+    }
+    stream.connect(results, ec);
+    bool connected = !ec;
+
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / rate));
+    auto next = std::chrono::steady_clock::now();
+    beast::flat_buffer buffer;
+    for (std::size_t i = 0; std::chrono::steady_clock::now() < end; ++i)
+    {
+        std::this_thread::sleep_until(next);
+        next += period;
+        if (!connected)
+        { // we reconnect, at the pace of the values..
+            stream.close();
+            stream.connect(results, ec);
+            if (ec)
+            {
+                st.publish_errors++;
+                continue;
+            }
+            connected = true;
+        }
+
+        http::request<http::string_body> req{http::verb::post, "/sensor/" + opts.sensors[i % opts.sensors.size()], 11};
+        req.set(http::field::host, opts.host);
+        req.set(http::field::content_type, "application/json");
+        req.set("token", opts.token);
+        req.keep_alive(true);
+        req.body() = opts.value;
+        req.prepare_payload();
+
+        const auto start = std::chrono::steady_clock::now();
+        http::write(stream, req, ec);
+        http::response<http::string_body> res;
+        if (!ec)
+            http::read(stream, buffer, res, ec);
+        if (ec)
+        { // we reconnect before the next value..
+            st.publish_errors++;
+            connected = false;
+            continue;
+        }
+        const std::uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (res.result() != http::status::ok)
+            st.publish_errors++;
+        st.published++;
+        st.publish_us += us;
+        for (auto max = st.publish_max_us.load(); us > max && !st.publish_max_us.compare_exchange_weak(max, us);)
+            ;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    options opts;
+    // we parse the command line arguments..
+    for (int i = 1; i < argc - 1; i++)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "-host")
+            opts.host = argv[++i];
+        else if (arg == "-port")
+            opts.port = argv[++i];
+        else if (arg == "-token")
+            opts.token = argv[++i];
+        else if (arg == "-clients")
+            opts.clients = std::stoul(argv[++i]);
+        else if (arg == "-sensors")
+            while (i + 1 < argc && argv[i + 1][0] != '-')
+                opts.sensors.push_back(argv[++i]);
+        else if (arg == "-value")
+            opts.value = argv[++i];
+        else if (arg == "-rate")
+            opts.rate = std::stod(argv[++i]);
+        else if (arg == "-publishers")
+            opts.publishers = std::stoul(argv[++i]);
+        else if (arg == "-duration")
+            opts.duration = std::stoul(argv[++i]);
+        else if (arg == "-format")
+            opts.msgpack = std::string(argv[++i]) == "msgpack";
+        else if (arg == "-compress")
+            opts.compress = std::string(argv[++i]) == "true";
+    }
+    if (opts.token.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " -token <token> [-host <host>] [-port <port>] [-clients <n>] [-sensors <id>...] [-value <json>] [-rate <values/s>] [-publishers <n>] [-duration <s>] [-format json|msgpack] [-compress true|false]" << std::endl;
+        return 1;
+    }
+
+    stats st;
+    net::io_context ioc;
+    for (std::size_t i = 0; i < opts.clients; ++i)
+        std::make_shared<client>(ioc, opts, st)->start();
+    std::vector<std::thread> io_threads;
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+        io_threads.emplace_back([&ioc]()
+                                { ioc.run(); });
+
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(opts.duration);
+    std::vector<std::thread> publishers;
+    if (opts.rate > 0 && !opts.sensors.empty())
+        for (std::size_t i = 0; i < opts.publishers; ++i)
+            publishers.emplace_back(publish, std::cref(opts), std::ref(st), opts.rate / opts.publishers, end);
+
+    // we report the throughput every second..
+    std::size_t messages = 0, bytes = 0, published = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const std::size_t c_messages = st.messages, c_bytes = st.bytes, c_published = st.published;
+        std::cout << "clients: " << st.connected << " (" << st.failed << " failed)"
+                  << ", received: " << c_messages - messages << " msg/s, " << (c_bytes - bytes) / 1024 << " KiB/s"
+                  << ", published: " << c_published - published << " values/s (" << st.publish_errors << " errors, avg " << (c_published ? st.publish_us / c_published : 0) << " us, max " << st.publish_max_us << " us)" << std::endl;
+        messages = c_messages;
+        bytes = c_bytes;
+        published = c_published;
+    }
+
+    for (auto &p : publishers)
+        p.join();
+    ioc.stop();
+    for (auto &t : io_threads)
+        t.join();
+
+    return 0;
+}
@@ -1,10 +1,18 @@
 #include "coco_gui.h"
 #include "mongo_db.h"
 #include "mqtt_middleware.h"
+#include <charconv>
+#include <iostream>
 
 int main(int argc, char const *argv[])
 {
     std::vector<std::string> rules;
+    std::vector<std::pair<std::string, std::size_t>> recent_values; // the number of recent values kept in memory for the sensors of some types..
+    std::string record, replay, relay, token;
+    std::string host = COCO_HOST;
+    unsigned short port = COCO_PORT;
+    double speed = 1;
+    long delay = 5;
     // we parse the command line arguments..
     for (int i = 1; i < argc - 1; i++)
         if (std::string(argv[i]) == "-rules")
@@ -13,23 +21,106 @@ int main(int argc, char const *argv[])
             rules.clear();
             while (i < argc && argv[i][0] != '-')
                 rules.push_back(argv[i++]);
+            i--;
         }
+        else if (std::string(argv[i]) == "-recent_values")
+        { // given as <sensor type id>=<number of values>..
+            i++;
+            while (i < argc && argv[i][0] != '-')
+            {
+                const std::string arg = argv[i++];
+                const auto eq = arg.rfind('=');
+                std::size_t capacity = 0;
+                std::from_chars_result parsed{nullptr, std::errc::invalid_argument};
+                if (eq != std::string::npos && eq > 0)
+                    parsed = std::from_chars(arg.data() + eq + 1, arg.data() + arg.size(), capacity);
+                if (parsed.ec != std::errc() || parsed.ptr != arg.data() + arg.size())
+                { // the sensor type id and the number of values are both required, the latter being a plain decimal number..
+                    std::cerr << "Invalid recent values '" << arg << "', expected <sensor type id>=<number of values>" << std::endl;
+                    return 1;
+                }
+                recent_values.emplace_back(arg.substr(0, eq), capacity);
+            }
+            i--;
+        }
+        else if (std::string(argv[i]) == "-record")
+            record = argv[++i];
+        else if (std::string(argv[i]) == "-replay")
+            replay = argv[++i];
+        else if (std::string(argv[i]) == "-speed")
+            speed = std::stod(argv[++i]);
+        else if (std::string(argv[i]) == "-delay")
+            delay = std::stol(argv[++i]);
+        else if (std::string(argv[i]) == "-host")
+            host = argv[++i];
+        else if (std::string(argv[i]) == "-port")
+            port = static_cast<unsigned short>(std::stoul(argv[++i]));
+        else if (std::string(argv[i]) == "-relay")
+            relay = argv[++i];
+        else if (std::string(argv[i]) == "-token")
+            token = argv[++i];
 
     mongocxx::instance inst{}; // This should be done only once.
 
     coco::mongo_db mongodb;
     coco::coco_core cc(mongodb);
 
-    cc.add_middleware(new coco::mqtt_middleware(cc));
+    if (!replay.empty())
+    { // the recorded events are fed to the GUI, neither the middleware nor the solvers being started..
+        coco::coco_gui::coco_gui gui(cc, host, port);
+        gui.set_guest_logins(true);
+        std::thread replayer([&gui, &replay, speed, delay]()
+                             {
+                                 std::this_thread::sleep_for(std::chrono::seconds(delay)); // the clients have the time to connect..
+                                 const auto start = std::chrono::steady_clock::now();
+                                 const auto n = gui.replay(replay, speed);
+                                 LOG_INFO("Replayed " << n << " events in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms"); });
+        gui.network::server::start();
+        replayer.join();
+        return 0;
+    }
 
-    cc.connect();
+    if (!relay.empty())
+    { // the stream of the primary (given as host:port) is served to the clients of this relay, neither the middleware nor the solvers being started..
+        const auto colon = relay.rfind(':');
+        coco::coco_gui::coco_gui gui(cc, host, port);
+        gui.set_ready(false);
+        gui.set_upstream(relay.substr(0, colon), colon == std::string::npos ? std::to_string(COCO_PORT) : relay.substr(colon + 1), token);
+        std::thread relayer([&gui]()
+                            { gui.relay(); });
+        gui.network::server::start();
+        relayer.join();
+        return 0;
+    }
 
-    cc.load_rules(rules);
+    // the server is up right away, answering that it is starting until the core is initialized..
+    coco::coco_gui::coco_gui gui(cc, host, port);
+    gui.set_ready(false);
+    for (const auto &[sensor_type_id, capacity] : recent_values)
+        gui.set_recent_values_capacity(sensor_type_id, capacity);
+    if (!record.empty())
+        gui.start_recording(record);
 
-    cc.init();
+    cc.add_middleware(new coco::mqtt_middleware(cc));
 
-    coco::coco_gui::coco_gui gui(cc);
+    std::thread initializer([&cc, &gui, &rules]()
+                            {
+                                const auto timed = [&gui](const std::string &phase, const std::function<void()> &f)
+                                {
+                                    const auto start = std::chrono::steady_clock::now();
+                                    f();
+                                    gui.startup_phase(phase, std::chrono::steady_clock::now() - start);
+                                };
+                                // the core is not safe to connect while loading the rules, so the phases run one after the other..
+                                timed("connect", [&cc]()
+                                      { cc.connect(); });
+                                timed("load_rules", [&cc, &rules]()
+                                      { cc.load_rules(rules); });
+                                timed("init", [&cc]()
+                                      { cc.init(); });
+                                gui.set_ready(true); });
     gui.network::server::start();
+    initializer.join();
 
     return 0;
 }
@@ -0,0 +1,251 @@
+#include "metrics.h"
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace coco::coco_gui
+{
+    static std::string with(const std::string &labels, const std::string &label)
+    {
+        if (labels.empty())
+            return '{' + label + '}';
+        return '{' + labels + ',' + label + '}';
+    }
+
+    static std::string format(const double v)
+    {
+        char tmp[32];
+        std::snprintf(tmp, sizeof(tmp), "%g", v);
+        return tmp;
+    }
+
+    void histogram::write(std::string &out, const std::string &name, const std::string &labels, const double scale, const std::size_t first, const std::size_t last) const
+    {
+        std::uint64_t count = 0;
+        for (std::size_t i = 0; i < n_buckets; ++i)
+        {
+            count += buckets[i].load(std::memory_order_relaxed);
+            if (i >= first && i < last && i + 1 < n_buckets) // every exported bucket is written, even when empty, so that the series of the histogram never change..
+                out += name + "_bucket" + with(labels, "le=\"" + format(static_cast<double>(std::uint64_t(1) << i) * scale) + '"') + ' ' + std::to_string(count) + '\n';
+        }
+        out += name + "_bucket" + with(labels, "le=\"+Inf\"") + ' ' + std::to_string(count) + '\n';
+        out += name + "_sum" + (labels.empty() ? "" : '{' + labels + '}') + ' ' + format(sum.load(std::memory_order_relaxed) * scale) + '\n';
+        out += name + "_count" + (labels.empty() ? "" : '{' + labels + '}') + ' ' + std::to_string(count) + '\n';
+    }
+
+    void server_metrics::write(std::string &out) const
+    {
+        // the exported buckets: the durations, recorded in microseconds, from 1 us to about a minute, the sizes from 64 bytes to 1 GiB (the others being folded into their neighbours)..
+        static constexpr std::pair<std::size_t, std::size_t> duration_buckets{0, 27}, size_buckets{6, 31};
+        out += "# HELP coco_gui_http_request_duration_seconds The time taken to serve the HTTP requests.\n# TYPE coco_gui_http_request_duration_seconds histogram\n";
+        routes.for_each([&out](const std::string &route, const route_metrics &m)
+                        { m.latency.write(out, "coco_gui_http_request_duration_seconds", "route=\"" + route + '"', 1e-6, duration_buckets.first, duration_buckets.second); });
+        out += "# HELP coco_gui_http_request_size_bytes The size of the HTTP request bodies.\n# TYPE coco_gui_http_request_size_bytes histogram\n";
+        routes.for_each([&out](const std::string &route, const route_metrics &m)
+                        { m.request_size.write(out, "coco_gui_http_request_size_bytes", "route=\"" + route + '"', 1, size_buckets.first, size_buckets.second); });
+        out += "# HELP coco_gui_http_response_size_bytes The size of the HTTP response bodies.\n# TYPE coco_gui_http_response_size_bytes histogram\n";
+        routes.for_each([&out](const std::string &route, const route_metrics &m)
+                        { m.response_size.write(out, "coco_gui_http_response_size_bytes", "route=\"" + route + '"', 1, size_buckets.first, size_buckets.second); });
+
+        out += "# HELP coco_gui_core_lock_wait_seconds The time spent waiting for the core mutex.\n# TYPE coco_gui_core_lock_wait_seconds histogram\n";
+        lock_sites.for_each([&out](const std::string &site, const lock_site &s)
+                            { s.wait.write(out, "coco_gui_core_lock_wait_seconds", "site=\"" + site + '"', 1e-6, duration_buckets.first, duration_buckets.second); });
+        out += "# HELP coco_gui_core_lock_hold_seconds The time the core mutex is held.\n# TYPE coco_gui_core_lock_hold_seconds histogram\n";
+        lock_sites.for_each([&out](const std::string &site, const lock_site &s)
+                            { s.hold.write(out, "coco_gui_core_lock_hold_seconds", "site=\"" + site + '"', 1e-6, duration_buckets.first, duration_buckets.second); });
+
+        out += "# HELP coco_gui_messages_total The solver and sensor events, by type.\n# TYPE coco_gui_messages_total counter\n";
+        messages.for_each([&out](const std::string &type, const counter &c)
+                          { out += "coco_gui_messages_total{type=\"" + type + "\"} " + std::to_string(c.get()) + '\n'; });
+
+        out += "# HELP coco_gui_fanout_duration_seconds The time taken to deliver a message to the sessions.\n# TYPE coco_gui_fanout_duration_seconds histogram\n";
+        fanout.write(out, "coco_gui_fanout_duration_seconds", "", 1e-6, duration_buckets.first, duration_buckets.second);
+        out += "# HELP coco_gui_write_delay_seconds The time the sensor values waited to be written to the database.\n# TYPE coco_gui_write_delay_seconds histogram\n";
+        write_delay.write(out, "coco_gui_write_delay_seconds", "", 1e-6, duration_buckets.first, duration_buckets.second);
+        out += "# HELP coco_gui_broadcasts_total The broadcast messages.\n# TYPE coco_gui_broadcasts_total counter\ncoco_gui_broadcasts_total " + std::to_string(broadcasts.get()) + '\n';
+        out += "# HELP coco_gui_broadcast_bytes_total The size of the broadcast messages.\n# TYPE coco_gui_broadcast_bytes_total counter\ncoco_gui_broadcast_bytes_total " + std::to_string(broadcast_bytes.get()) + '\n';
+    }
+
+    namespace
+    {
+        struct lock_sample
+        {
+            std::array<const lock_site *, lock_profiler::max_depth> stack;
+            std::size_t depth;
+            std::uint64_t wait_us, hold_us;
+        };
+
+        struct lock_buffer
+        {
+            std::mutex mtx; // contended only while the buffer is being drained..
+            std::vector<lock_sample> samples;
+        };
+
+        struct lock_totals
+        {
+            std::uint64_t count = 0, wait_us = 0, hold_us = 0;
+        };
+
+        constexpr std::size_t max_buffered_samples = 1 << 16; // the samples exceeding this are dropped until the next drain..
+
+        thread_local std::array<const lock_site *, lock_profiler::max_depth> held_sites; // the sites of the acquisitions the thread holds..
+        thread_local std::size_t held_depth = 0;
+
+        std::mutex buffers_mtx;
+        std::vector<std::shared_ptr<lock_buffer>> buffers;
+
+        std::mutex profile_mtx;
+        std::map<std::vector<const lock_site *>, lock_totals> profile;
+
+        std::mutex control_mtx;
+        std::condition_variable control_cv;
+        std::thread aggregator;
+
+        lock_buffer &local_buffer()
+        {
+            thread_local const std::shared_ptr<lock_buffer> buf = []()
+            {
+                auto b = std::make_shared<lock_buffer>();
+                std::lock_guard<std::mutex> _(buffers_mtx);
+                buffers.push_back(b);
+                return b;
+            }();
+            return *buf;
+        }
+
+        /**
+         * @brief Moves the samples of all the threads into the profile.
+         */
+        void drain()
+        {
+            std::vector<lock_sample> samples, c_samples;
+            {
+                std::lock_guard<std::mutex> _(buffers_mtx);
+                for (auto it = buffers.begin(); it != buffers.end();)
+                {
+                    {
+                        std::lock_guard<std::mutex> _(it->get()->mtx);
+                        c_samples.swap(it->get()->samples);
+                    }
+                    samples.insert(samples.end(), c_samples.begin(), c_samples.end());
+                    c_samples.clear();
+                    if (it->use_count() == 1) // the thread has exited..
+                        it = buffers.erase(it);
+                    else
+                        ++it;
+                }
+            }
+
+            std::lock_guard<std::mutex> _(profile_mtx);
+            for (const auto &s : samples)
+            {
+                auto &t = profile[std::vector<const lock_site *>(s.stack.begin(), s.stack.begin() + std::min(s.depth, lock_profiler::max_depth))];
+                t.count++;
+                t.wait_us += s.wait_us;
+                t.hold_us += s.hold_us;
+            }
+        }
+    } // namespace
+
+    void lock_profiler::start()
+    {
+        std::lock_guard<std::mutex> _(control_mtx);
+        if (active.exchange(true))
+            return;
+        aggregator = std::thread([]()
+                                 {
+                                     std::unique_lock<std::mutex> lock(control_mtx);
+                                     while (active)
+                                     {
+                                         control_cv.wait_for(lock, std::chrono::milliseconds(100));
+                                         drain();
+                                     } });
+    }
+    void lock_profiler::stop()
+    {
+        std::thread c_aggregator;
+        {
+            std::lock_guard<std::mutex> _(control_mtx);
+            if (!active.exchange(false))
+                return;
+            control_cv.notify_one();
+            c_aggregator.swap(aggregator);
+        }
+        c_aggregator.join();
+        drain();
+    }
+    void lock_profiler::reset()
+    {
+        drain();
+        std::lock_guard<std::mutex> _(profile_mtx);
+        profile.clear();
+    }
+
+    void lock_profiler::enter(const lock_site &site)
+    {
+        if (held_depth < max_depth)
+            held_sites[held_depth] = &site;
+        held_depth++;
+    }
+    void lock_profiler::exit(const std::chrono::steady_clock::duration &wait, const std::chrono::steady_clock::duration &hold)
+    {
+        lock_sample s{held_sites, held_depth, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(wait).count()), static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(hold).count())};
+        held_depth--;
+
+        auto &buf = local_buffer();
+        std::lock_guard<std::mutex> _(buf.mtx);
+        if (buf.samples.size() < max_buffered_samples)
+            buf.samples.push_back(s);
+    }
+
+    void lock_profiler::write(std::string &out, const family<lock_site> &sites, const metric m)
+    {
+        std::unordered_map<const lock_site *, std::string> names;
+        sites.for_each([&names](const std::string &label, const lock_site &s)
+                       { names.emplace(&s, label); });
+
+        drain();
+        std::lock_guard<std::mutex> _(profile_mtx);
+        std::map<std::vector<const lock_site *>, std::uint64_t> nested_hold; // the time held by the nested acquisitions, by stack of their parent..
+        if (m == metric::hold)
+            for (const auto &[stack, t] : profile)
+                if (stack.size() > 1)
+                    nested_hold[std::vector<const lock_site *>(stack.begin(), stack.end() - 1)] += t.hold_us;
+
+        for (const auto &[stack, t] : profile)
+        {
+            std::uint64_t value = 0;
+            switch (m)
+            {
+            case metric::wait:
+                value = t.wait_us;
+                break;
+            case metric::hold:
+                if (auto it = nested_hold.find(stack); it != nested_hold.end())
+                    value = t.hold_us > it->second ? t.hold_us - it->second : 0;
+                else
+                    value = t.hold_us;
+                break;
+            case metric::count:
+                value = t.count;
+                break;
+            }
+            if (!value)
+                continue;
+
+            for (std::size_t i = 0; i < stack.size(); ++i)
+            {
+                if (i)
+                    out += ';';
+                auto it = names.find(stack[i]);
+                out += it != names.end() ? it->second : "unknown";
+            }
+            out += ' ' + std::to_string(value) + '\n';
+        }
+    }
+} // namespace coco::coco_gui
@@ -0,0 +1,390 @@
+#include "msgpack.h"
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace coco::coco_gui
+{
+    template <typename T>
+    static void write_be(std::string &out, const T v)
+    {
+        for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8)
+            out += static_cast<char>((v >> shift) & 0xFF);
+    }
+
+    static void write_header(std::string &out, const std::size_t size, const unsigned char fix, const std::size_t fix_max, const unsigned char h8, const unsigned char h16, const unsigned char h32)
+    {
+        if (size <= fix_max)
+            out += static_cast<char>(fix | size);
+        else if (h8 && size <= 0xFF)
+        {
+            out += static_cast<char>(h8);
+            out += static_cast<char>(size);
+        }
+        else if (size <= 0xFFFF)
+        {
+            out += static_cast<char>(h16);
+            write_be(out, static_cast<uint16_t>(size));
+        }
+        else
+        {
+            out += static_cast<char>(h32);
+            write_be(out, static_cast<uint32_t>(size));
+        }
+    }
+
+    static void write_string(std::string &out, const std::string_view &s)
+    {
+        write_header(out, s.size(), 0xA0, 31, 0xD9, 0xDA, 0xDB);
+        out += s;
+    }
+    static void write_string(std::string &out, const std::string &s) { write_string(out, std::string_view(s)); }
+
+    static void write_integer(std::string &out, const long v)
+    {
+        if (v >= 0)
+        {
+            if (v <= 0x7F)
+                out += static_cast<char>(v);
+            else if (v <= 0xFF)
+            {
+                out += static_cast<char>(0xCC);
+                out += static_cast<char>(v);
+            }
+            else if (v <= 0xFFFF)
+            {
+                out += static_cast<char>(0xCD);
+                write_be(out, static_cast<uint16_t>(v));
+            }
+            else if (v <= 0xFFFFFFFFL)
+            {
+                out += static_cast<char>(0xCE);
+                write_be(out, static_cast<uint32_t>(v));
+            }
+            else
+            {
+                out += static_cast<char>(0xCF);
+                write_be(out, static_cast<uint64_t>(v));
+            }
+        }
+        else if (v >= -32)
+            out += static_cast<char>(v);
+        else if (v >= std::numeric_limits<int8_t>::min())
+        {
+            out += static_cast<char>(0xD0);
+            out += static_cast<char>(v);
+        }
+        else if (v >= std::numeric_limits<int16_t>::min())
+        {
+            out += static_cast<char>(0xD1);
+            write_be(out, static_cast<uint16_t>(v));
+        }
+        else if (v >= std::numeric_limits<int32_t>::min())
+        {
+            out += static_cast<char>(0xD2);
+            write_be(out, static_cast<uint32_t>(v));
+        }
+        else
+        {
+            out += static_cast<char>(0xD3);
+            write_be(out, static_cast<uint64_t>(v));
+        }
+    }
+
+    static void write_float(std::string &out, const double v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        out += static_cast<char>(0xCB);
+        write_be(out, bits);
+    }
+
+    void write_msgpack(std::string &out, json::json &value)
+    {
+        switch (value.get_type())
+        {
+        case json::json_type::null:
+            out += static_cast<char>(0xC0);
+            break;
+        case json::json_type::boolean:
+            out += static_cast<char>(static_cast<bool>(value) ? 0xC3 : 0xC2);
+            break;
+        case json::json_type::number:
+        {
+            const double d = value;
+            if (std::trunc(d) == d && std::abs(d) < 9.2e18)
+                write_integer(out, static_cast<long>(value));
+            else
+                write_float(out, d);
+            break;
+        }
+        case json::json_type::string:
+            write_string(out, value);
+            break;
+        case json::json_type::array:
+            write_header(out, value.size(), 0x90, 15, 0, 0xDC, 0xDD);
+            for (size_t i = 0; i < value.size(); ++i)
+                write_msgpack(out, value[i]);
+            break;
+        case json::json_type::object:
+        {
+            auto &members = value.get_object();
+            write_header(out, members.size(), 0x80, 15, 0, 0xDE, 0xDF);
+            for (auto &[key, member] : members)
+            {
+                write_string(out, key);
+                write_msgpack(out, member);
+            }
+            break;
+        }
+        }
+    }
+
+    std::string to_msgpack(json::json &value)
+    {
+        std::string out;
+        write_msgpack(out, value);
+        return out;
+    }
+
+    struct json_text
+    {
+        const std::string_view text;
+        std::size_t pos = 0;
+
+        void skip_ws()
+        {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+                ++pos;
+        }
+        char next()
+        {
+            skip_ws();
+            if (pos >= text.size())
+                throw std::invalid_argument("Unexpected end of the JSON text");
+            return text[pos++];
+        }
+        void expect(const std::string_view &literal)
+        {
+            if (text.compare(pos - 1, literal.size(), literal) != 0)
+                throw std::invalid_argument("Invalid JSON literal at " + std::to_string(pos - 1));
+            pos += literal.size() - 1;
+        }
+    };
+
+    static void append_utf8(std::string &out, const unsigned long cp)
+    {
+        if (cp < 0x80)
+            out += static_cast<char>(cp);
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    static unsigned long read_hex4(json_text &in)
+    {
+        unsigned long v = 0;
+        if (in.pos + 4 > in.text.size() || std::from_chars(in.text.data() + in.pos, in.text.data() + in.pos + 4, v, 16).ptr != in.text.data() + in.pos + 4)
+            throw std::invalid_argument("Invalid unicode escape at " + std::to_string(in.pos));
+        in.pos += 4;
+        return v;
+    }
+
+    /**
+     * @brief Transcodes the string starting after the opening quote.
+     */
+    static void transcode_string(std::string &out, json_text &in)
+    {
+        const auto end = in.text.find_first_of("\"\\", in.pos);
+        if (end == std::string_view::npos)
+            throw std::invalid_argument("Unterminated JSON string");
+        if (in.text[end] == '"')
+        { // no escapes, the common case: the bytes are copied as they are..
+            write_string(out, in.text.substr(in.pos, end - in.pos));
+            in.pos = end + 1;
+            return;
+        }
+        std::string s(in.text.substr(in.pos, end - in.pos));
+        in.pos = end;
+        while (true)
+        {
+            if (in.pos >= in.text.size())
+                throw std::invalid_argument("Unterminated JSON string");
+            const char c = in.text[in.pos++];
+            if (c == '"')
+                break;
+            if (c != '\\')
+            {
+                s += c;
+                continue;
+            }
+            if (in.pos >= in.text.size())
+                throw std::invalid_argument("Unterminated JSON string");
+            switch (const char e = in.text[in.pos++]; e)
+            {
+            case 'b':
+                s += '\b';
+                break;
+            case 'f':
+                s += '\f';
+                break;
+            case 'n':
+                s += '\n';
+                break;
+            case 'r':
+                s += '\r';
+                break;
+            case 't':
+                s += '\t';
+                break;
+            case 'u':
+            {
+                auto cp = read_hex4(in);
+                if (cp >= 0xD800 && cp < 0xDC00 && in.text.compare(in.pos, 2, "\\u") == 0)
+                { // a surrogate pair..
+                    in.pos += 2;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (read_hex4(in) - 0xDC00);
+                }
+                append_utf8(s, cp);
+                break;
+            }
+            default: // '"', '\\' and '/' stand for themselves..
+                s += e;
+            }
+        }
+        write_string(out, s);
+    }
+
+    static void transcode_number(std::string &out, json_text &in)
+    {
+        const auto start = --in.pos;
+        bool integral = true;
+        while (in.pos < in.text.size() && (std::isdigit(static_cast<unsigned char>(in.text[in.pos])) || in.text[in.pos] == '-' || in.text[in.pos] == '+' || in.text[in.pos] == '.' || in.text[in.pos] == 'e' || in.text[in.pos] == 'E'))
+            if (const char c = in.text[in.pos++]; c == '.' || c == 'e' || c == 'E')
+                integral = false;
+        const char *first = in.text.data() + start, *last = in.text.data() + in.pos;
+        if (integral)
+        {
+            long v;
+            if (auto [ptr, ec] = std::from_chars(first, last, v); ec == std::errc() && ptr == last)
+            {
+                write_integer(out, v);
+                return;
+            }
+        }
+        double d;
+        if (auto [ptr, ec] = std::from_chars(first, last, d); ec != std::errc() || ptr != last)
+            throw std::invalid_argument("Invalid JSON number at " + std::to_string(start));
+        if (std::trunc(d) == d && std::abs(d) < 9.2e18) // the same rule as for the trees..
+            write_integer(out, static_cast<long>(d));
+        else
+            write_float(out, d);
+    }
+
+    static void transcode_value(std::string &out, json_text &in);
+
+    /**
+     * @brief Transcodes the array, or the object, starting after its opening bracket.
+     *
+     * The number of elements is known only at the end, hence the header is inserted before them once they are written.
+     */
+    static void transcode_container(std::string &out, json_text &in, const bool object)
+    {
+        const auto start = out.size();
+        const char close = object ? '}' : ']';
+        std::size_t n = 0;
+        in.skip_ws();
+        if (in.pos < in.text.size() && in.text[in.pos] == close)
+            ++in.pos;
+        else
+            while (true)
+            {
+                if (object)
+                {
+                    if (in.next() != '"')
+                        throw std::invalid_argument("Expected a key at " + std::to_string(in.pos - 1));
+                    transcode_string(out, in);
+                    if (in.next() != ':')
+                        throw std::invalid_argument("Expected ':' at " + std::to_string(in.pos - 1));
+                }
+                transcode_value(out, in);
+                ++n;
+                if (const char c = in.next(); c == close)
+                    break;
+                else if (c != ',')
+                    throw std::invalid_argument("Expected ',' or '" + std::string(1, close) + "' at " + std::to_string(in.pos - 1));
+            }
+        std::string header;
+        if (object)
+            write_header(header, n, 0x80, 15, 0, 0xDE, 0xDF);
+        else
+            write_header(header, n, 0x90, 15, 0, 0xDC, 0xDD);
+        out.insert(start, header);
+    }
+
+    static void transcode_value(std::string &out, json_text &in)
+    {
+        switch (const char c = in.next(); c)
+        {
+        case '{':
+            transcode_container(out, in, true);
+            break;
+        case '[':
+            transcode_container(out, in, false);
+            break;
+        case '"':
+            transcode_string(out, in);
+            break;
+        case 't':
+            in.expect("true");
+            out += static_cast<char>(0xC3);
+            break;
+        case 'f':
+            in.expect("false");
+            out += static_cast<char>(0xC2);
+            break;
+        case 'n':
+            in.expect("null");
+            out += static_cast<char>(0xC0);
+            break;
+        default:
+            transcode_number(out, in);
+        }
+    }
+
+    void write_msgpack(std::string &out, const std::string_view &text)
+    {
+        json_text in{text};
+        transcode_value(out, in);
+        in.skip_ws();
+        if (in.pos != text.size())
+            throw std::invalid_argument("Unexpected content after the JSON value at " + std::to_string(in.pos));
+    }
+
+    std::string to_msgpack(const std::string_view &text)
+    {
+        std::string out;
+        out.reserve(text.size()); // the encoding is, usually, a bit shorter than the text..
+        write_msgpack(out, text);
+        return out;
+    }
+} // namespace coco::coco_gui
@@ -0,0 +1,238 @@
+#include "sensor_series.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace coco::coco_gui
+{
+    /**
+     * @brief Computes the minimum, the maximum, the sum and the number of the non-NaN values of the given array.
+     *
+     * The loop is branch-free and uses four independent accumulators, so that the compiler can vectorize it without reassociating floating point operations.
+     */
+    static void reduce(const double *v, const size_t n, double &min, double &max, double &sum, size_t &count)
+    {
+        double mn[4], mx[4], sm[4];
+        size_t cnt[4] = {0, 0, 0, 0};
+        for (size_t k = 0; k < 4; ++k)
+        {
+            mn[k] = std::numeric_limits<double>::infinity();
+            mx[k] = -std::numeric_limits<double>::infinity();
+            sm[k] = 0;
+        }
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const double x = v[i + k];
+                const bool valid = x == x;
+                mn[k] = valid && x < mn[k] ? x : mn[k];
+                mx[k] = valid && x > mx[k] ? x : mx[k];
+                sm[k] += valid ? x : 0;
+                cnt[k] += valid;
+            }
+        for (; i < n; ++i)
+        {
+            const double x = v[i];
+            const bool valid = x == x;
+            mn[0] = valid && x < mn[0] ? x : mn[0];
+            mx[0] = valid && x > mx[0] ? x : mx[0];
+            sm[0] += valid ? x : 0;
+            cnt[0] += valid;
+        }
+
+        min = std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3]));
+        max = std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3]));
+        sum = (sm[0] + sm[1]) + (sm[2] + sm[3]);
+        count = cnt[0] + cnt[1] + cnt[2] + cnt[3];
+    }
+
+    sensor_series::sensor_series(const std::map<std::string, parameter_type> &parameters, const size_t capacity) : capacity(capacity)
+    {
+        for (const auto &[name, type] : parameters)
+            columns.push_back({name, type == parameter_type::Integer || type == parameter_type::Float, type == parameter_type::Integer, {}, {}});
+    }
+
+    sensor_series::sensor_series(const std::vector<column> &layout, const size_t capacity) : capacity(capacity)
+    {
+        for (const auto &c : layout)
+            columns.push_back({c.name, c.numeric, c.integer, {}, {}});
+    }
+
+    /**
+     * @brief Returns the JSON value of the given number of a numeric column.
+     */
+    static json::json number(const bool integer, const double v) { return integer ? json::json(static_cast<long>(v)) : json::json(v); }
+
+    void sensor_series::push_back(json::json &value) { push_back(static_cast<long>(value["timestamp"]), value["value"]); }
+    void sensor_series::push_back(const long timestamp, json::json &val)
+    {
+        if (capacity && timestamps.size() == capacity)
+        { // we discard the oldest half of the values..
+            const size_t n = capacity / 2 + 1;
+            timestamps.erase(timestamps.begin(), timestamps.begin() + n);
+            for (auto &c : columns)
+                if (c.numeric)
+                    c.numbers.erase(c.numbers.begin(), c.numbers.begin() + n);
+                else
+                    c.values.erase(c.values.begin(), c.values.begin() + n);
+        }
+
+        timestamps.push_back(timestamp);
+        for (auto &c : columns)
+            if (c.numeric)
+                c.numbers.push_back(val.has(c.name) ? static_cast<double>(val[c.name]) : std::numeric_limits<double>::quiet_NaN());
+            else
+                c.values.push_back(val.has(c.name) ? val[c.name] : json::json());
+    }
+
+    sensor_series sensor_series::range(const long from, const long to) const
+    {
+        sensor_series r(columns, 0);
+        const size_t i0 = std::distance(timestamps.begin(), std::lower_bound(timestamps.begin(), timestamps.end(), from));
+        const size_t i1 = std::distance(timestamps.begin(), std::upper_bound(timestamps.begin() + i0, timestamps.end(), to));
+        r.timestamps.assign(timestamps.begin() + i0, timestamps.begin() + i1);
+        for (size_t c = 0; c < columns.size(); ++c)
+            if (columns[c].numeric)
+                r.columns[c].numbers.assign(columns[c].numbers.begin() + i0, columns[c].numbers.begin() + i1);
+            else
+                r.columns[c].values.assign(columns[c].values.begin() + i0, columns[c].values.begin() + i1);
+        return r;
+    }
+
+    bool sensor_series::for_each(const long from, const long to, const std::function<bool(json::json &)> &f) const
+    {
+        for (auto it = std::lower_bound(timestamps.begin(), timestamps.end(), from); it != timestamps.end() && *it <= to; ++it)
+        {
+            const size_t i = std::distance(timestamps.begin(), it);
+            json::json j_val(json::json_type::object);
+            for (const auto &c : columns)
+                if (c.numeric)
+                {
+                    if (c.numbers[i] == c.numbers[i])
+                        j_val[c.name] = number(c.integer, c.numbers[i]);
+                }
+                else if (c.values[i].get_type() != json::json_type::null)
+                    j_val[c.name] = c.values[i];
+            json::json j_v{{"timestamp", *it}};
+            j_v["value"] = std::move(j_val);
+            if (!f(j_v))
+                return false;
+        }
+        return true;
+    }
+
+    json::json sensor_series::downsample(const long from, const long to, const long bucket) const
+    {
+        json::json values(json::json_type::array);
+        auto it = std::lower_bound(timestamps.begin(), timestamps.end(), from);
+        while (it != timestamps.end() && *it < to)
+        { // we jump to the bucket of the next value, skipping the empty ones..
+            const long b_from = from + ((*it - from) / bucket) * bucket;
+            const auto b_end = std::lower_bound(it, timestamps.end(), std::min(b_from + bucket, to));
+            const size_t i0 = std::distance(timestamps.begin(), it), i1 = std::distance(timestamps.begin(), b_end);
+
+            json::json j_val(json::json_type::object), j_min(json::json_type::object), j_max(json::json_type::object);
+            for (const auto &c : columns)
+                if (c.numeric)
+                {
+                    double min, max, sum;
+                    size_t count;
+                    reduce(c.numbers.data() + i0, i1 - i0, min, max, sum, count);
+                    if (count)
+                    {
+                        j_val[c.name] = sum / count;
+                        j_min[c.name] = number(c.integer, min);
+                        j_max[c.name] = number(c.integer, max);
+                    }
+                }
+                else
+                    for (size_t i = i1; i > i0; --i)
+                        if (c.values[i - 1].get_type() != json::json_type::null)
+                        { // we take the last value of the bucket..
+                            j_val[c.name] = c.values[i - 1];
+                            break;
+                        }
+
+            json::json j_v{{"timestamp", timestamps[i1 - 1]}};
+            j_v["value"] = std::move(j_val);
+            j_v["min"] = std::move(j_min);
+            j_v["max"] = std::move(j_max);
+            j_v["count"] = static_cast<long>(i1 - i0);
+            values.push_back(std::move(j_v));
+            it = b_end;
+        }
+        return values;
+    }
+
+    sensor_downsampler::sensor_downsampler(const std::map<std::string, parameter_type> &parameters, const long from, const long to, const long bucket) : from(from), to(to), bucket(bucket), values(json::json_type::array)
+    {
+        for (const auto &[name, type] : parameters)
+            accumulators.push_back({name, type == parameter_type::Integer || type == parameter_type::Float, type == parameter_type::Integer, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0, 0, json::json()});
+    }
+
+    void sensor_downsampler::push_back(json::json &value)
+    {
+        const auto timestamp = static_cast<long>(value["timestamp"]);
+        if (timestamp < from || timestamp >= to)
+            return;
+        if (count && timestamp >= b_from + bucket)
+            flush(); // the value opens a new bucket..
+        if (!count)
+            b_from = from + ((timestamp - from) / bucket) * bucket;
+
+        auto &val = value["value"];
+        for (auto &a : accumulators)
+            if (!val.has(a.name))
+                continue;
+            else if (a.numeric)
+            {
+                const auto x = static_cast<double>(val[a.name]);
+                a.min = std::min(a.min, x);
+                a.max = std::max(a.max, x);
+                a.sum += x;
+                a.count++;
+            }
+            else if (val[a.name].get_type() != json::json_type::null)
+                a.last = val[a.name];
+        last = timestamp;
+        count++;
+    }
+
+    json::json sensor_downsampler::finish()
+    {
+        if (count)
+            flush();
+        return std::move(values);
+    }
+
+    void sensor_downsampler::flush()
+    {
+        json::json j_val(json::json_type::object), j_min(json::json_type::object), j_max(json::json_type::object);
+        for (auto &a : accumulators)
+        {
+            if (a.numeric && a.count)
+            {
+                j_val[a.name] = a.sum / a.count;
+                j_min[a.name] = number(a.integer, a.min);
+                j_max[a.name] = number(a.integer, a.max);
+            }
+            else if (!a.numeric && a.last.get_type() != json::json_type::null)
+                j_val[a.name] = std::move(a.last);
+            a.min = std::numeric_limits<double>::infinity();
+            a.max = -std::numeric_limits<double>::infinity();
+            a.sum = 0;
+            a.count = 0;
+            a.last = json::json();
+        }
+
+        json::json j_v{{"timestamp", last}};
+        j_v["value"] = std::move(j_val);
+        j_v["min"] = std::move(j_min);
+        j_v["max"] = std::move(j_max);
+        j_v["count"] = static_cast<long>(count);
+        values.push_back(std::move(j_v));
+        count = 0;
+    }
+} // namespace coco::coco_gui
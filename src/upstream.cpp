@@ -0,0 +1,105 @@
+#include "upstream.h"
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/beast/http.hpp>
+
+namespace coco::coco_gui
+{
+    /**
+     * @brief Runs the asynchronous operation started by `start` to completion, the operation being bounded by the expiry of its stream.
+     *
+     * @throws upstream_error if the operation fails, or times out.
+     */
+    template <typename Start>
+    static void complete(boost::asio::io_context &ioc, Start &&start)
+    {
+        boost::system::error_code ec;
+        start([&ec](const boost::system::error_code &e, auto &&...)
+              { ec = e; });
+        ioc.restart();
+        ioc.run();
+        if (ec)
+            throw upstream_error("Cannot reach the primary server: " + ec.message());
+    }
+
+    static boost::asio::ip::tcp::resolver::results_type resolve(boost::asio::io_context &ioc, const std::string &host, const std::string &port)
+    {
+        boost::system::error_code ec;
+        auto results = boost::asio::ip::tcp::resolver(ioc).resolve(host, port, ec);
+        if (ec)
+            throw upstream_error("Cannot resolve the primary server: " + ec.message());
+        return results;
+    }
+
+    upstream_link::upstream_link(const std::string &host, const std::string &port) : ws(ioc)
+    {
+        const auto results = resolve(ioc, host, port);
+        auto &stream = boost::beast::get_lowest_layer(ws);
+        stream.expires_after(upstream_timeout);
+        complete(ioc, [&](auto &&handler)
+                 { stream.async_connect(results, handler); });
+        stream.socket().set_option(boost::asio::ip::tcp::no_delay(true));
+        stream.expires_never(); // the stream has timeouts of its own..
+
+        boost::beast::websocket::stream_base::timeout timeout;
+        timeout.handshake_timeout = upstream_timeout;
+        timeout.idle_timeout = upstream_timeout; // the primary is pinged once half of it has elapsed without a message..
+        timeout.keep_alive_pings = true;
+        ws.set_option(timeout);
+        ws.read_message_max(64 * 1024 * 1024); // the graphs of the solvers come in a single message..
+        complete(ioc, [&](auto &&handler)
+                 { ws.async_handshake(host + ':' + port, "/coco", handler); });
+        ws.text(true);
+    }
+    upstream_link::~upstream_link()
+    {
+        boost::system::error_code ec;
+        boost::beast::get_lowest_layer(ws).socket().close(ec);
+    }
+
+    void upstream_link::write(const std::string &msg)
+    {
+        complete(ioc, [&](auto &&handler)
+                 { ws.async_write(boost::asio::buffer(msg), handler); });
+    }
+
+    std::string upstream_link::read()
+    {
+        buffer.clear();
+        complete(ioc, [&](auto &&handler)
+                 { ws.async_read(buffer, handler); });
+        return boost::beast::buffers_to_string(buffer.data());
+    }
+
+    upstream_response upstream_get(const std::string &host, const std::string &port, const std::string &target, const std::string &token, const std::string &etag)
+    {
+        boost::asio::io_context ioc;
+        boost::beast::tcp_stream stream(ioc);
+        stream.expires_after(upstream_timeout); // the whole exchange, from the connection to the response..
+        const auto results = resolve(ioc, host, port);
+        complete(ioc, [&](auto &&handler)
+                 { stream.async_connect(results, handler); });
+
+        boost::beast::http::request<boost::beast::http::empty_body> req{boost::beast::http::verb::get, target, 11};
+        req.set(boost::beast::http::field::host, host + ':' + port);
+        req.set("token", token);
+        if (!etag.empty())
+            req.set(boost::beast::http::field::if_none_match, etag);
+        complete(ioc, [&](auto &&handler)
+                 { boost::beast::http::async_write(stream, req, handler); });
+
+        boost::beast::flat_buffer buffer;
+        boost::beast::http::response<boost::beast::http::string_body> res;
+        complete(ioc, [&](auto &&handler)
+                 { boost::beast::http::async_read(stream, buffer, res, handler); });
+        boost::system::error_code ec;
+        stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+
+        upstream_response r{res.result_int(), {}, std::move(res.body())};
+        if (res.count(boost::beast::http::field::etag))
+        {
+            const auto c_etag = res[boost::beast::http::field::etag];
+            r.etag.assign(c_etag.data(), c_etag.size());
+        }
+        return r;
+    }
+} // namespace coco::coco_gui
@@ -0,0 +1,108 @@
+#include "event_log.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+using namespace coco::coco_gui;
+
+static const std::string path = (std::filesystem::temp_directory_path() / "coco_test_event_log.bin").string();
+
+static void write_log()
+{
+    event_log_writer w(path);
+    w.write(event_kind::broadcast, "{\"type\":\"new_sensor_value\"}", true, "sensor:s0", {"sensor:s0"});
+    w.write(event_kind::solver_event, "{\"type\":\"flaw_created\"}", false, "flaw_created", {}, "1", 300);
+    w.write(event_kind::flush, {}, false, {}, {}, "1");
+    w.write(event_kind::broadcast, std::string(1000, 'x'), true, {}, {"solver:1", "sensor:s1"});
+}
+
+static void test_round_trip()
+{
+    write_log();
+
+    event_log_reader r(path);
+    event_record rec;
+    assert(r.next(rec));
+    assert(rec.kind == event_kind::broadcast && rec.to_all && rec.key == "sensor:s0" && rec.payload == "{\"type\":\"new_sensor_value\"}");
+    assert(rec.topics.size() == 1 && rec.topics[0] == "sensor:s0" && rec.solver_id.empty() && rec.item == 0);
+    auto last = rec.time;
+
+    assert(r.next(rec));
+    assert(rec.kind == event_kind::solver_event && !rec.to_all && rec.key == "flaw_created" && rec.solver_id == "1" && rec.item == 300 && rec.topics.empty());
+    assert(rec.time >= last); // the times never go back..
+    last = rec.time;
+
+    assert(r.next(rec));
+    assert(rec.kind == event_kind::flush && rec.solver_id == "1" && rec.payload.empty() && rec.key.empty() && rec.item == 0);
+    assert(rec.time >= last);
+
+    assert(r.next(rec));
+    assert(rec.payload == std::string(1000, 'x') && rec.topics.size() == 2 && rec.topics[1] == "sensor:s1");
+
+    assert(!r.next(rec));
+}
+
+static void test_truncation()
+{ // a log cut in the middle of its last record, as left by a crash, still gives its complete records..
+    write_log();
+    std::string content;
+    {
+        std::ifstream in(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    for (const std::size_t cut : {1, 10, 500})
+    {
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(content.data(), content.size() - cut);
+        }
+        event_log_reader r(path);
+        event_record rec;
+        std::size_t n = 0;
+        while (r.next(rec))
+            n++;
+        assert(n == 3);
+    }
+}
+
+static void test_flush()
+{ // the records reach the file, through the writer thread, while the writer is still open..
+    event_log_writer w(path);
+    w.write(event_kind::broadcast, "{\"type\":\"tick\"}");
+    w.flush();
+
+    event_log_reader r(path);
+    event_record rec;
+    assert(r.next(rec) && rec.payload == "{\"type\":\"tick\"}");
+    assert(!r.next(rec));
+}
+
+static void test_not_a_log()
+{
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "{\"type\":\"graph\"}";
+    }
+    bool thrown = false;
+    try
+    {
+        event_log_reader r(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+int main()
+{
+    test_round_trip();
+    test_truncation();
+    test_flush();
+    test_not_a_log();
+
+    std::filesystem::remove(path);
+    return 0;
+}
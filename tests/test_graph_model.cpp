@@ -0,0 +1,101 @@
+#include "graph_model.h"
+#include <cassert>
+
+using namespace coco::coco_gui;
+
+static json::json graph()
+{
+    json::json g{{"type", "graph"}, {"solver_id", 1L}, {"current_flaw", 0L}};
+    json::json flaws(json::json_type::array);
+    flaws.push_back({{"id", 0L}, {"label", "φ0"}, {"state", "active"}, {"cost", 1.5}});
+    g["flaws"] = std::move(flaws);
+    g["resolvers"] = json::json(json::json_type::array);
+    return g;
+}
+
+static std::string cost_changed(const long id, const double cost)
+{
+    return json::json{{"type", "flaw_cost_changed"}, {"solver_id", 1L}, {"id", id}, {"cost", cost}}.to_string();
+}
+
+static void apply(graph_model &gm, const std::string &msg)
+{
+    auto j_msg = json::load(msg);
+    gm.apply(j_msg);
+}
+
+static void test_apply()
+{
+    graph_model gm(1L, graph());
+    assert(gm.get_version() == 0);
+
+    json::json created{{"type", "flaw_created"}, {"solver_id", 1L}, {"id", 1L}, {"label", "φ1"}, {"state", "active"}, {"cost", 2.0}};
+    auto s_created = json::load(gm.apply(created));
+    assert(static_cast<long>(s_created["version"]) == 1); // the events are stamped with the version they produce..
+    apply(gm, cost_changed(0, 3.5));
+    apply(gm, cost_changed(42, 1.0)); // an unknown item is ignored, yet the version moves on..
+    json::json current{{"type", "current_flaw"}, {"solver_id", 1L}, {"id", 1L}};
+    gm.apply(current);
+    assert(gm.get_version() == 4);
+
+    auto j_gr = json::load(gm.snapshot());
+    assert(j_gr["type"] == "graph");
+    assert(static_cast<long>(j_gr["version"]) == 4 && static_cast<long>(j_gr["epoch"]) == gm.get_epoch());
+    assert(j_gr["flaws"].size() == 2 && j_gr["resolvers"].size() == 0);
+    assert(static_cast<double>(j_gr["flaws"][0]["cost"]) == 3.5);
+    assert(j_gr["flaws"][1]["label"] == "φ1");
+    assert(static_cast<long>(j_gr["current_flaw"]) == 1);
+    assert(gm.snapshot() == gm.snapshot()); // the snapshot is serialized once per version..
+}
+
+static void test_deltas()
+{
+    graph_model gm(1L, graph(), 4);
+    const auto epoch = gm.get_epoch();
+
+    auto deltas = gm.deltas(epoch, 0);
+    assert(deltas && deltas->empty()); // the client is already up to date..
+
+    for (long i = 0; i < 3; ++i)
+        apply(gm, cost_changed(0, static_cast<double>(i)));
+
+    deltas = gm.deltas(epoch, 1);
+    assert(deltas);
+    auto j_batch = json::load(*deltas);
+    assert(j_batch["type"] == "batch");
+    assert(static_cast<long>(j_batch["epoch"]) == epoch && static_cast<long>(j_batch["version"]) == 3);
+    assert(j_batch["messages"].size() == 2);
+    assert(static_cast<long>(j_batch["messages"][0]["version"]) == 2 && static_cast<long>(j_batch["messages"][1]["version"]) == 3);
+
+    assert(!gm.deltas(epoch + 1, 1)); // the versions of another run of the server..
+    assert(!gm.deltas(epoch, 4));     // a version the graph has never reached..
+}
+
+static void test_trimming()
+{ // only the last events are kept, older versions needing the whole graph..
+    graph_model gm(1L, graph(), 4);
+    const auto epoch = gm.get_epoch();
+    for (long i = 0; i < 6; ++i)
+        apply(gm, cost_changed(0, static_cast<double>(i)));
+
+    assert(!gm.deltas(epoch, 0));
+    assert(!gm.deltas(epoch, 1));
+    auto deltas = gm.deltas(epoch, 2);
+    assert(deltas);
+    auto j_batch = json::load(*deltas);
+    assert(j_batch["messages"].size() == 4);
+    assert(static_cast<long>(j_batch["messages"][0]["version"]) == 3);
+    assert(static_cast<double>(j_batch["messages"][3]["cost"]) == 5);
+
+    deltas = gm.deltas(epoch, 5);
+    assert(deltas && json::load(*deltas)["messages"].size() == 1);
+}
+
+int main()
+{
+    test_apply();
+    test_deltas();
+    test_trimming();
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "mpsc_queue.h"
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace coco::coco_gui;
+
+static void test_fifo()
+{
+    mpsc_queue<int> q;
+    assert(q.empty());
+    assert(!q.pop());
+
+    for (int i = 0; i < 10; ++i)
+        q.push(int(i));
+    assert(!q.empty());
+    for (int i = 0; i < 10; ++i)
+    {
+        auto v = q.pop();
+        assert(v && *v == i);
+    }
+    assert(q.empty());
+    assert(!q.pop());
+}
+
+static void test_producers()
+{
+    constexpr int producers = 4, n = 100000;
+    mpsc_queue<std::pair<int, int>> q;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+        threads.emplace_back([&q, p]()
+                             { for (int i = 0; i < n; ++i)
+                                   q.push({p, i}); });
+
+    // the values of each producer come out in the order they were pushed..
+    std::vector<int> next(producers, 0);
+    for (int popped = 0; popped < producers * n;)
+        if (auto v = q.pop())
+        {
+            assert(v->second == next[v->first]);
+            next[v->first]++;
+            popped++;
+        }
+    for (auto &t : threads)
+        t.join();
+    assert(q.empty());
+}
+
+static void test_destruction()
+{ // the values left in the queue are destroyed with it..
+    auto value = std::make_shared<int>(42);
+    {
+        mpsc_queue<std::shared_ptr<int>> q;
+        q.push(std::shared_ptr<int>(value));
+        q.push(std::shared_ptr<int>(value));
+        assert(value.use_count() == 3);
+    }
+    assert(value.use_count() == 1);
+}
+
+int main()
+{
+    test_fifo();
+    test_producers();
+    test_destruction();
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "msgpack.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+
+using namespace coco::coco_gui;
+
+/**
+ * @brief Returns the MessagePack encoding of the `v` member of the given object.
+ */
+static std::string encode(json::json j)
+{
+    std::string out;
+    write_msgpack(out, j["v"]);
+    return out;
+}
+
+static std::string bytes(std::initializer_list<unsigned char> b) { return std::string(b.begin(), b.end()); }
+
+static void test_scalars()
+{
+    assert(encode({{"v", json::json()}}) == bytes({0xC0}));
+    assert(encode({{"v", true}}) == bytes({0xC3}));
+    assert(encode({{"v", false}}) == bytes({0xC2}));
+
+    assert(encode({{"v", 0L}}) == bytes({0x00}));
+    assert(encode({{"v", 127L}}) == bytes({0x7F}));
+    assert(encode({{"v", 200L}}) == bytes({0xCC, 0xC8}));
+    assert(encode({{"v", 65535L}}) == bytes({0xCD, 0xFF, 0xFF}));
+    assert(encode({{"v", 65536L}}) == bytes({0xCE, 0x00, 0x01, 0x00, 0x00}));
+    assert(encode({{"v", 1700000000000L}}) == bytes({0xCF, 0x00, 0x00, 0x01, 0x8B, 0xCF, 0xE5, 0x68, 0x00}));
+    assert(encode({{"v", -1L}}) == bytes({0xFF}));
+    assert(encode({{"v", -32L}}) == bytes({0xE0}));
+    assert(encode({{"v", -33L}}) == bytes({0xD0, 0xDF}));
+    assert(encode({{"v", -129L}}) == bytes({0xD1, 0xFF, 0x7F}));
+
+    assert(encode({{"v", 2.0}}) == bytes({0x02})); // integral numbers are encoded as integers..
+    assert(encode({{"v", 1.5}}) == bytes({0xCB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+}
+
+static void test_strings()
+{
+    assert(encode({{"v", ""}}) == bytes({0xA0}));
+    assert(encode({{"v", "abc"}}) == bytes({0xA3, 'a', 'b', 'c'}));
+    assert(encode({{"v", std::string(31, 'x')}}) == bytes({0xBF}) + std::string(31, 'x'));
+    assert(encode({{"v", std::string(32, 'x')}}) == bytes({0xD9, 0x20}) + std::string(32, 'x'));
+    assert(encode({{"v", std::string(256, 'x')}}) == bytes({0xDA, 0x01, 0x00}) + std::string(256, 'x'));
+    assert(encode({{"v", "φ"}}) == bytes({0xA2, 0xCF, 0x86})); // the size is in bytes..
+}
+
+static void test_containers()
+{
+    json::json arr(json::json_type::array);
+    assert(encode({{"v", arr}}) == bytes({0x90}));
+    for (long i = 0; i < 15; ++i)
+        arr.push_back(i);
+    std::string expected = bytes({0x9F});
+    for (char i = 0; i < 15; ++i)
+        expected += i;
+    assert(encode({{"v", arr}}) == expected);
+    arr.push_back(15L);
+    assert(encode({{"v", arr}}).substr(0, 3) == bytes({0xDC, 0x00, 0x10})); // no 8-bit header for the arrays..
+
+    json::json obj{{"a", 1L}};
+    assert(to_msgpack(obj) == bytes({0x81, 0xA1, 'a', 0x01}));
+    json::json nested{{"a", json::json{{"b", json::json(json::json_type::array)}}}};
+    assert(to_msgpack(nested) == bytes({0x81, 0xA1, 'a', 0x81, 0xA1, 'b', 0x90}));
+}
+
+/**
+ * @brief Returns a text covering every MessagePack type (and size class) the server sends.
+ */
+static std::string sample()
+{
+    std::string text = "{\"type\":\"sample\",\"integers\":[0,127,128,255,256,65535,65536,4294967295,4294967296,1700000000000,-1,-32,-33,-128,-129,-32768,-32769,-2147483648,-2147483649],";
+    text += "\"floats\":[1.5,-0.25,2.0,12345.678],\"literals\":[true,false,null],\"empty\":{},\"none\":[],";
+    text += "\"strings\":[\"\",\"abc\",\"φ\",\"\\u00e9\\n\\t\\\"\\\\\\/\\ud83d\\ude00\",\"" + std::string(32, 'x') + "\",\"" + std::string(256, 'y') + "\",\"" + std::string(70000, 'z') + "\"],";
+    text += "\"long\":[";
+    for (int i = 0; i < 20; ++i)
+        text += (i ? "," : "") + std::to_string(i);
+    text += "],\"wide\":{";
+    for (int i = 0; i < 20; ++i)
+        text += std::string(i ? "," : "") + "\"k" + std::to_string(i) + "\":" + std::to_string(i);
+    text += "},\"nested\" : { \"a\" : [ { \"b\" : [ [ ] , { } ] } ] } }";
+    return text;
+}
+
+static void test_text()
+{ // the text is transcoded as its tree would be encoded..
+    for (const std::string text : {"null", "true", "0", "-1", "200", "1.5", "2.0", "\"abc\"", "\"a\\\"b\"", "[]", "{}", "[1,[2,[3]]]", "{\"a\":{\"b\":[]}}"})
+    {
+        auto j = json::load(text);
+        assert(to_msgpack(text) == to_msgpack(j));
+    }
+    assert(to_msgpack(std::string("\"\\u00e9\\ud83d\\ude00\"")) == bytes({0xA6, 0xC3, 0xA9, 0xF0, 0x9F, 0x98, 0x80})); // the escapes are decoded into UTF-8..
+    assert(to_msgpack(std::string(" [ 1 , 2 ] ")) == bytes({0x92, 0x01, 0x02}));
+    assert(to_msgpack(std::string("1e3")) == bytes({0xCD, 0x03, 0xE8}));
+
+    const auto text = sample();
+    auto j = json::load(text);
+    const auto bin = to_msgpack(text);
+    assert(bin.size() == to_msgpack(j).size()); // the members of the objects might be in another order..
+    assert(bin[0] == static_cast<char>(0x8A));
+    assert(bin.find(bytes({0xDE, 0x00, 0x14, 0xA2, 'k', '0'})) != std::string::npos); // the header is inserted once the members are counted..
+
+    for (const std::string invalid : {"", "[1,2", "{\"a\" 1}", "\"abc", "tru", "1x", "[1] 2"})
+    {
+        bool thrown = false;
+        try
+        {
+            to_msgpack(invalid);
+        }
+        catch (const std::invalid_argument &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+}
+
+/**
+ * @brief Writes the sample text, along with its encodings, for `test_msgpack_js.mjs` to decode them with the client's decoder.
+ */
+static void write_round_trip(const std::filesystem::path &dir)
+{
+    const auto text = sample();
+    auto j = json::load(text);
+    std::ofstream(dir / "sample.json", std::ios::binary) << text;
+    std::ofstream(dir / "sample_text.msgpack", std::ios::binary) << to_msgpack(text);
+    std::ofstream(dir / "sample_tree.msgpack", std::ios::binary) << to_msgpack(j);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        write_round_trip(argv[1]);
+        return 0;
+    }
+
+    test_scalars();
+    test_strings();
+    test_containers();
+    test_text();
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+// Decodes, with the client's decoder, the MessagePack encodings written by `test_msgpack <dir>`, checking that they give back the JSON text..
+import assert from 'node:assert/strict';
+import { execFileSync } from 'node:child_process';
+import { mkdtempSync, readFileSync, rmSync } from 'node:fs';
+import { tmpdir } from 'node:os';
+import { dirname, join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+const [test_msgpack] = process.argv.slice(2);
+if (!test_msgpack) {
+    console.error('Usage: node test_msgpack_js.mjs <path to test_msgpack>');
+    process.exit(2);
+}
+
+// the client sources are ES modules in a package which is not marked as such, hence the decoder is imported from its text..
+const source = readFileSync(join(dirname(fileURLToPath(import.meta.url)), '../client/src/msgpack.js'), 'utf8');
+const { decode } = await import('data:text/javascript,' + encodeURIComponent(source));
+
+const dir = mkdtempSync(join(tmpdir(), 'coco_msgpack_'));
+try {
+    execFileSync(test_msgpack, [dir]);
+    const expected = JSON.parse(readFileSync(join(dir, 'sample.json'), 'utf8'));
+    for (const file of ['sample_text.msgpack', 'sample_tree.msgpack']) {
+        const bytes = readFileSync(join(dir, file));
+        const decoded = decode(bytes.buffer.slice(bytes.byteOffset, bytes.byteOffset + bytes.byteLength));
+        assert.deepEqual(decoded, expected, file);
+    }
+} finally {
+    rmSync(dir, { recursive: true, force: true });
+}
@@ -0,0 +1,285 @@
+// Starts a primary server and two relays of it, as separate processes on the loopback interface, and checks that the relays serve the stream and the lists of the primary to their own clients..
+//
+// The servers need the database of the primary, hence the test is skipped unless the token of one of its admins is given through `COCO_ADMIN_TOKEN`.
+// The ports are taken from `COCO_TEST_PORT` on (18280 by default): the primary listens on the first one, the relays on the following two.
+import assert from 'node:assert/strict';
+import { spawn } from 'node:child_process';
+import { randomBytes } from 'node:crypto';
+import { request as http_request } from 'node:http';
+import { connect as tcp_connect } from 'node:net';
+import { dirname, join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+const [server_path] = process.argv.slice(2);
+if (!server_path) {
+    console.error('Usage: node test_relay.mjs <path to cocoGUIServer>');
+    process.exit(2);
+}
+const token = process.env.COCO_ADMIN_TOKEN;
+if (!token) {
+    console.log('COCO_ADMIN_TOKEN is not set, skipping the relay test..');
+    process.exit(77);
+}
+
+const host = '127.0.0.1';
+const primary_port = Number(process.env.COCO_TEST_PORT || 18280);
+const relay_ports = [primary_port + 1, primary_port + 2];
+const root = join(dirname(fileURLToPath(import.meta.url)), '..');
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+/**
+ * A server process, whose output is shown only if the test fails.
+ */
+class server_process {
+    constructor(name, args) {
+        this.name = name;
+        this.output = '';
+        this.process = spawn(server_path, args, { cwd: root });
+        this.process.stdout.on('data', (data) => this.output += data);
+        this.process.stderr.on('data', (data) => this.output += data);
+        this.exited = new Promise((resolve) => this.process.on('exit', resolve));
+    }
+
+    async stop() {
+        this.process.kill('SIGKILL');
+        await this.exited;
+    }
+}
+
+function request(port, method, path, headers = {}, body = undefined) {
+    return new Promise((resolve, reject) => {
+        const req = http_request({ host, port, method, path, headers, timeout: 15000 }, (res) => {
+            let data = '';
+            res.setEncoding('utf8');
+            res.on('data', (chunk) => data += chunk);
+            res.on('end', () => resolve({ status: res.statusCode, headers: res.headers, body: data }));
+        });
+        req.on('timeout', () => req.destroy(new Error(method + ' ' + path + ' timed out')));
+        req.on('error', reject);
+        req.end(body);
+    });
+}
+
+async function wait_ready(port, timeout = 30000) {
+    const deadline = Date.now() + timeout;
+    while (Date.now() < deadline) {
+        try {
+            if ((await request(port, 'GET', '/ready')).status === 200)
+                return;
+        } catch (e) { } // not listening yet..
+        await sleep(200);
+    }
+    throw new Error('The server on port ' + port + ' is not ready after ' + timeout + ' ms');
+}
+
+/**
+ * A minimal WebSocket client, enough for the JSON stream of the servers (Node.js has no client of its own before version 22).
+ */
+class ws_client {
+    static connect(port) {
+        return new Promise((resolve, reject) => {
+            const socket = tcp_connect(port, host);
+            const key = randomBytes(16).toString('base64');
+            let head = Buffer.alloc(0);
+            const on_data = (data) => {
+                head = Buffer.concat([head, data]);
+                const end = head.indexOf('\r\n\r\n');
+                if (end < 0)
+                    return;
+                socket.off('data', on_data);
+                if (!head.subarray(0, end).toString().startsWith('HTTP/1.1 101'))
+                    return reject(new Error('The WebSocket handshake was refused: ' + head.subarray(0, end).toString()));
+                resolve(new ws_client(socket, head.subarray(end + 4)));
+            };
+            socket.on('data', on_data);
+            socket.on('error', reject);
+            socket.write('GET /coco HTTP/1.1\r\nHost: ' + host + ':' + port + '\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: ' + key + '\r\nSec-WebSocket-Version: 13\r\n\r\n');
+        });
+    }
+
+    constructor(socket, rest) {
+        this.socket = socket;
+        this.buffer = Buffer.alloc(0);
+        this.fragments = [];
+        this.messages = [];
+        this.waiters = [];
+        this.close_code = undefined;
+        socket.on('data', (data) => this.receive(data));
+        socket.on('close', () => {
+            this.closed = true;
+            this.waiters.forEach((w) => w.check());
+        });
+        if (rest.length)
+            this.receive(rest);
+    }
+
+    receive(data) {
+        this.buffer = Buffer.concat([this.buffer, data]);
+        while (this.buffer.length >= 2) {
+            const opcode = this.buffer[0] & 0x0F, fin = this.buffer[0] & 0x80;
+            let length = this.buffer[1] & 0x7F, offset = 2;
+            if (length === 126) {
+                if (this.buffer.length < 4)
+                    return;
+                length = this.buffer.readUInt16BE(2);
+                offset = 4;
+            } else if (length === 127) {
+                if (this.buffer.length < 10)
+                    return;
+                length = Number(this.buffer.readBigUInt64BE(2));
+                offset = 10;
+            }
+            if (this.buffer.length < offset + length)
+                return;
+            const payload = this.buffer.subarray(offset, offset + length);
+            this.buffer = this.buffer.subarray(offset + length);
+
+            if (opcode === 0x8) {
+                this.close_code = payload.length >= 2 ? payload.readUInt16BE(0) : 1005;
+                this.socket.destroy();
+            } else if (opcode === 0x9)
+                this.write(0xA, payload);
+            else if (opcode === 0x1 || opcode === 0x2 || opcode === 0x0) {
+                this.fragments.push(payload);
+                if (fin) {
+                    this.messages.push(JSON.parse(Buffer.concat(this.fragments).toString('utf8')));
+                    this.fragments = [];
+                    this.waiters.forEach((w) => w.check());
+                }
+            }
+        }
+    }
+
+    write(opcode, payload) {
+        const mask = randomBytes(4);
+        const header = payload.length < 126 ? Buffer.from([0x80 | opcode, 0x80 | payload.length]) : Buffer.from([0x80 | opcode, 0x80 | 126, payload.length >> 8, payload.length & 0xFF]);
+        const masked = Buffer.from(payload);
+        for (let i = 0; i < masked.length; i++)
+            masked[i] ^= mask[i % 4];
+        this.socket.write(Buffer.concat([header, mask, masked]));
+    }
+
+    send(msg) { this.write(0x1, Buffer.from(JSON.stringify(msg))); }
+
+    /**
+     * Waits for the first message, received or to be received, satisfying the given predicate, and takes it out of the received ones.
+     */
+    next(predicate, what, timeout = 15000) {
+        return new Promise((resolve, reject) => {
+            const waiter = {
+                check: () => {
+                    const i = this.messages.findIndex(predicate);
+                    if (i >= 0) {
+                        done();
+                        resolve(this.messages.splice(i, 1)[0]);
+                    } else if (this.closed) {
+                        done();
+                        reject(new Error('The connection closed (' + this.close_code + ') while waiting for ' + what));
+                    }
+                }
+            };
+            const timer = setTimeout(() => {
+                done();
+                reject(new Error('Timed out waiting for ' + what));
+            }, timeout);
+            const done = () => {
+                clearTimeout(timer);
+                this.waiters = this.waiters.filter((w) => w !== waiter);
+            };
+            this.waiters.push(waiter);
+            waiter.check();
+        });
+    }
+
+    /**
+     * Forgets the messages received so far.
+     */
+    clear() { this.messages = []; }
+
+    close() { this.socket.destroy(); }
+}
+
+async function login(port) {
+    const ws = await ws_client.connect(port);
+    ws.send({ type: 'login', token: token });
+    const msg = await ws.next((m) => m.type === 'login', 'the login on port ' + port);
+    assert.equal(msg.success, true, 'the login on port ' + port);
+    return { ws, user: msg.user };
+}
+
+const servers = [];
+let failed = false;
+try {
+    const primary = new server_process('primary', ['-host', host, '-port', String(primary_port)]);
+    servers.push(primary);
+    await wait_ready(primary_port);
+    for (const port of relay_ports)
+        servers.push(new server_process('relay ' + port, ['-host', host, '-port', String(port), '-relay', host + ':' + primary_port, '-token', token]));
+    for (const port of relay_ports)
+        await wait_ready(port);
+
+    // the tokens are checked by the primary, along with the root of their user..
+    const principal = await request(primary_port, 'GET', '/principal', { token });
+    assert.equal(principal.status, 200, 'the admin token on the primary');
+    const j_principal = JSON.parse(principal.body);
+    assert.equal(j_principal.admin, true);
+    assert.equal(j_principal.member, true);
+    for (const port of relay_ports) {
+        const relayed = await request(port, 'GET', '/principal', { token });
+        assert.equal(relayed.status, 200, 'the admin token on relay ' + port);
+        assert.equal(JSON.parse(relayed.body).user.id, j_principal.user.id);
+        assert.equal((await request(port, 'GET', '/principal', { token: 'not-a-token' })).status, 401, 'an invalid token on relay ' + port);
+    }
+
+    // the lists are those of the primary, cached by the relays..
+    const users = await request(relay_ports[0], 'GET', '/users', { token });
+    assert.equal(users.status, 200, 'the users list on a relay');
+    assert.ok(JSON.parse(users.body).users.some((u) => u.id === j_principal.user.id));
+    assert.equal((await request(relay_ports[0], 'GET', '/users', { token, 'if-none-match': users.headers.etag })).status, 304, 'the cached users list on a relay');
+
+    // the clients of the relays get the snapshot, then the messages of the primary..
+    const clients = [];
+    for (const port of relay_ports) {
+        const client = await login(port);
+        assert.equal(client.user.id, j_principal.user.id);
+        await client.ws.next((m) => m.type === 'solvers', 'the solvers on relay ' + port);
+        await client.ws.next((m) => m.type === 'users', 'the users on relay ' + port);
+        await client.ws.next((m) => m.type === 'user_connected', 'the login on relay ' + port); // announced by the relay itself..
+        clients.push(client);
+    }
+    clients.forEach((c) => c.ws.clear());
+    const direct = await login(primary_port);
+    for (const [i, client] of clients.entries())
+        await client.ws.next((m) => m.type === 'user_connected' && m.user === j_principal.user.id, 'the login on the primary, through relay ' + relay_ports[i]);
+    direct.ws.close();
+
+    // the writes are redirected to the primary, which lets the browsers follow the redirect from another origin..
+    const redirected = await request(relay_ports[0], 'POST', '/sensor_type', { token, 'content-type': 'application/json' }, '{}');
+    assert.equal(redirected.status, 307, 'a write on a relay');
+    assert.equal(redirected.headers.location, 'http://' + host + ':' + primary_port + '/sensor_type');
+    const preflight = await request(primary_port, 'OPTIONS', '/sensor_type', { origin: 'http://' + host + ':' + relay_ports[0], 'access-control-request-method': 'POST', 'access-control-request-headers': 'token, content-type' });
+    assert.equal(preflight.status, 204, 'the preflight of a redirected write');
+    assert.equal(preflight.headers['access-control-allow-origin'], '*');
+    assert.match(preflight.headers['access-control-allow-headers'], /token/);
+
+    // without the primary, the relays stay up, refusing the tokens they cannot check..
+    clients.forEach((c) => c.ws.clear());
+    await primary.stop();
+    assert.equal((await request(relay_ports[0], 'GET', '/ready')).status, 200, 'a relay without its primary');
+    assert.equal((await request(relay_ports[0], 'GET', '/principal', { token: 'not-a-token' })).status, 502, 'an unchecked token on a relay without its primary');
+
+    // once the primary is back, the relays reconnect and bring their clients up to date..
+    servers[0] = new server_process('primary', ['-host', host, '-port', String(primary_port)]);
+    await wait_ready(primary_port);
+    for (const [i, client] of clients.entries())
+        await client.ws.next((m) => m.type === 'users', 'the users list after relay ' + relay_ports[i] + ' reconnected', 30000);
+    clients.forEach((c) => c.ws.close());
+} catch (e) {
+    failed = true;
+    console.error(e);
+    for (const s of servers)
+        console.error('--- ' + s.name + ' ---\n' + s.output);
+} finally {
+    await Promise.all(servers.map((s) => s.stop()));
+}
+process.exit(failed ? 1 : 0);
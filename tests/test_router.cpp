@@ -0,0 +1,84 @@
+#include "router.h"
+#include <cassert>
+
+using namespace coco::coco_gui;
+using boost::beast::http::verb;
+
+static void test_match()
+{
+    router<int> r;
+    r.add(verb::get, "/sensors", 0);
+    r.add(verb::post, "/sensors", 1);
+    r.add(verb::get, "/sensor/:id", 2);
+    r.add(verb::get, "/sensor/types", 3);
+    r.add(verb::get, "/sensor/:id/values/:from", 4);
+
+    path_params params;
+    auto h = r.match(verb::get, "/sensors", params);
+    assert(h && *h == 0 && params.size() == 0);
+    h = r.match(verb::post, "/sensors", params);
+    assert(h && *h == 1);
+    assert(!r.match(verb::put, "/sensors", params));
+
+    h = r.match(verb::get, "/sensor/abc", params);
+    assert(h && *h == 2 && params.size() == 1 && params[0] == "abc");
+
+    // the static segments are preferred over the parameters..
+    path_params t_params;
+    h = r.match(verb::get, "/sensor/types", t_params);
+    assert(h && *h == 3 && t_params.size() == 0);
+
+    path_params v_params;
+    h = r.match(verb::get, "/sensor/abc/values/10", v_params);
+    assert(h && *h == 4 && v_params.size() == 2 && v_params[0] == "abc" && v_params[1] == "10");
+
+    path_params n_params;
+    assert(!r.match(verb::get, "/sensor", n_params));
+    assert(!r.match(verb::get, "/sensor/", n_params));
+    assert(!r.match(verb::get, "/sensor/abc/values", n_params));
+    assert(!r.match(verb::get, "sensors", n_params));
+    assert(!r.match(verb::get, "", n_params));
+    assert(n_params.size() == 0); // the parameters of the failed attempts are discarded..
+}
+
+static void test_backtracking()
+{ // a static segment which leads nowhere falls back to the parameter..
+    router<int> r;
+    r.add(verb::get, "/user/me/roots", 0);
+    r.add(verb::get, "/user/:id/data", 1);
+
+    path_params params;
+    auto h = r.match(verb::get, "/user/me/data", params);
+    assert(h && *h == 1 && params.size() == 1 && params[0] == "me");
+
+    path_params r_params;
+    h = r.match(verb::get, "/user/me/roots", r_params);
+    assert(h && *h == 0 && r_params.size() == 0);
+}
+
+static void test_query()
+{
+    const std::string_view target = "/sensor/abc?from=10&to=x20&flag&points=";
+    assert(path_of(target) == "/sensor/abc");
+    assert(query_of(target) == "from=10&to=x20&flag&points=");
+    assert(query_of("/sensors").empty());
+
+    const query_params query(query_of(target));
+    assert(query.get("from") == "10");
+    assert(query.has("flag") && query.get("flag")->empty());
+    assert(query.has("points") && query.get("points")->empty());
+    assert(!query.has("fro"));
+    assert(query.get_number<long>("from") == 10);
+    assert(!query.get_number<long>("to")); // not a number..
+    assert(!query.get_number<long>("points"));
+    assert(!query.get_number<long>("missing"));
+}
+
+int main()
+{
+    test_match();
+    test_backtracking();
+    test_query();
+
+    return 0;
+}
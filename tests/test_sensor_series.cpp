@@ -0,0 +1,134 @@
+#include "sensor_series.h"
+#include <cassert>
+
+using namespace coco::coco_gui;
+
+static const std::map<std::string, coco::parameter_type> parameters{{"temperature", coco::parameter_type::Float}, {"status", coco::parameter_type::Symbol}};
+
+static void push(sensor_series &series, const long timestamp, const double temperature, const std::string &status)
+{
+    json::json value{{"temperature", temperature}, {"status", status}};
+    series.push_back(timestamp, value);
+}
+
+static void test_downsample()
+{
+    sensor_series series(parameters);
+    for (long i = 0; i < 10; ++i)
+        push(series, i, static_cast<double>(i), "s" + std::to_string(i));
+
+    auto values = series.downsample(0, 10, 5);
+    assert(values.size() == 2);
+    assert(static_cast<long>(values[0]["timestamp"]) == 4); // the timestamp of the last value of the bucket..
+    assert(static_cast<long>(values[0]["count"]) == 5);
+    assert(static_cast<double>(values[0]["value"]["temperature"]) == 2);
+    assert(static_cast<double>(values[0]["min"]["temperature"]) == 0);
+    assert(static_cast<double>(values[0]["max"]["temperature"]) == 4);
+    assert(values[0]["value"]["status"] == "s4"); // the other parameters take the last value..
+    assert(static_cast<long>(values[1]["timestamp"]) == 9);
+    assert(static_cast<double>(values[1]["value"]["temperature"]) == 7);
+
+    // the interval is half-open..
+    values = series.downsample(2, 9, 100);
+    assert(values.size() == 1);
+    assert(static_cast<long>(values[0]["count"]) == 7);
+    assert(static_cast<long>(values[0]["timestamp"]) == 8);
+
+    assert(series.downsample(10, 20, 5).size() == 0);
+}
+
+static void test_sparse()
+{ // the empty buckets are skipped, and the missing values ignored..
+    sensor_series series(parameters);
+    push(series, 0, 1, "a");
+    push(series, 1, 3, "b");
+    json::json value{{"status", "c"}};
+    series.push_back(25, value);
+    push(series, 27, 10, "d");
+
+    auto values = series.downsample(0, 100, 10);
+    assert(values.size() == 2);
+    assert(static_cast<long>(values[0]["timestamp"]) == 1);
+    assert(static_cast<double>(values[0]["value"]["temperature"]) == 2);
+    assert(static_cast<long>(values[1]["timestamp"]) == 27);
+    assert(static_cast<long>(values[1]["count"]) == 2);
+    assert(static_cast<double>(values[1]["value"]["temperature"]) == 10);
+    assert(static_cast<double>(values[1]["min"]["temperature"]) == 10);
+    assert(values[1]["value"]["status"] == "d");
+
+    // a bucket without numeric values has no average..
+    values = series.downsample(20, 26, 10);
+    assert(values.size() == 1);
+    assert(!values[0]["value"].has("temperature") && !values[0]["min"].has("temperature"));
+    assert(values[0]["value"]["status"] == "c");
+}
+
+static void test_capacity()
+{ // a full series discards its oldest half..
+    sensor_series series(parameters, 8);
+    for (long i = 0; i < 9; ++i)
+        push(series, i, static_cast<double>(i), "s");
+    assert(series.size() == 4);
+    assert(series.front_timestamp() == 5 && series.back_timestamp() == 8);
+
+    long n = 0;
+    series.for_each(0, 100, [&n](json::json &v)
+                    {
+                        assert(static_cast<long>(v["timestamp"]) == 5 + n);
+                        assert(static_cast<double>(v["value"]["temperature"]) == 5 + n);
+                        return ++n < 2; });
+    assert(n == 2);
+}
+
+static void test_integers()
+{ // the integer parameters are given back as integers..
+    sensor_series series({{"humidity", coco::parameter_type::Integer}});
+    for (long i = 0; i < 4; ++i)
+    {
+        json::json value{{"humidity", 40 + i}};
+        series.push_back(i, value);
+    }
+
+    auto values = series.range(1, 2);
+    assert(values.size() == 2 && values.front_timestamp() == 1 && values.back_timestamp() == 2);
+    values.for_each(0, 100, [](json::json &v)
+                    {
+                        assert(v["value"]["humidity"].to_string() == std::to_string(40 + static_cast<long>(v["timestamp"])));
+                        return true; });
+
+    auto reduced = series.downsample(0, 4, 4);
+    assert(reduced.size() == 1);
+    assert(reduced[0]["min"]["humidity"].to_string() == "40" && reduced[0]["max"]["humidity"].to_string() == "43");
+    assert(static_cast<double>(reduced[0]["value"]["humidity"]) == 41.5); // the average needs not be an integer..
+}
+
+static void test_downsampler()
+{ // the values read from the database are reduced as the in-memory ones..
+    sensor_series series(parameters);
+    sensor_downsampler reducer(parameters, 2, 30, 5);
+    for (long i = 0; i < 40; i += 3)
+    {
+        push(series, i, static_cast<double>(i), "s" + std::to_string(i));
+        json::json value{{"timestamp", i}};
+        value["value"] = json::json{{"temperature", static_cast<double>(i)}, {"status", "s" + std::to_string(i)}};
+        reducer.push_back(value);
+    }
+
+    auto expected = series.downsample(2, 30, 5);
+    auto values = reducer.finish();
+    assert(values.size() == expected.size() && values.size() == 6);
+    assert(values.to_string() == expected.to_string());
+    assert(static_cast<long>(values[0]["timestamp"]) == 6 && static_cast<long>(values[0]["count"]) == 2); // the values before `from` are ignored..
+    assert(static_cast<long>(values[5]["timestamp"]) == 27);                                                // as are those from `to` on..
+}
+
+int main()
+{
+    test_downsample();
+    test_sparse();
+    test_capacity();
+    test_integers();
+    test_downsampler();
+
+    return 0;
+}